@@ -0,0 +1,210 @@
+#include "chunked.hpp"
+#include "generator.hpp"
+#include "maze.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+// single threaded generator throughput over a seed range, one line per mode, then each MazeGenerator
+// strategy's throughput and metric distributions, then the cost of MazeBuilder::regenerate for a few
+// region sizes
+// usage: bench [--from N] [--count N] [--runs N]
+//        bench --giant N [--chunk N] [--threads T] [--runs N]
+// --giant times one N x N ChunkedMaze at 1, 2, 4 ... T threads instead, best of the runs for each
+
+struct BenchResult {
+    double secs = 0;
+    uint64_t corridors = 0;
+};
+
+BenchResult run(bool symmetric, uint64_t from, uint64_t count) {
+    BenchResult r;
+    MazeBuilder m(0);
+    m.setSymmetric(symmetric);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t seed = from; seed < from + count; seed++) {
+        m.reset((uint32_t) seed);
+        m.generate();
+        // keeps the compiler from skipping the work and doubles as a sanity number
+        r.corridors += std::count(m.grid().begin(), m.grid().end(), cell_path);
+    }
+    r.secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return r;
+}
+
+// throughput of every strategy in generator.hpp on the default board, relative to the walk, then
+// p10 / median / p90 (mean) of the MazeMetrics numbers over the first mazes of the range
+void benchGenerators(uint64_t from, uint64_t count, int runs) {
+    MazeBuilder shape(0);
+    double baseline = 0;
+    for (const char* name : generator_names) {
+        auto gen = makeGenerator(name);
+        BenchResult best;
+        for (int i = 0; i < runs; i++) {
+            BenchResult r;
+            auto start = std::chrono::steady_clock::now();
+            for (uint64_t seed = from; seed < from + count; seed++) {
+                gen->generate((uint32_t) seed, shape.width(), shape.height(), shape.startX(), shape.startY());
+                r.corridors += std::count(gen->grid().begin(), gen->grid().end(), cell_path);
+            }
+            r.secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if ((i == 0) || (r.secs < best.secs)) {
+                best = r;
+            }
+        }
+        double rate = count / std::max(best.secs, 1e-9);
+        if (baseline == 0) {
+            baseline = rate;
+        }
+        std::cout << name << ": " << (uint64_t) rate << " mazes/s, " << (best.secs * 1e6 / count) << " us/maze, "
+                  << (double) best.corridors / count << " corridor tiles/maze, " << rate / baseline << "x\n";
+    }
+
+    const char* metric_names[] = {"corridor tiles", "dead ends", "junctions", "left/right gap", "avg distance", "score"};
+    const int metric_count = 6;
+    uint64_t sample = std::min<uint64_t>(count, 20000);
+    std::cout << "metrics over " << sample << " mazes, p10 / median / p90 (mean)\n";
+    MazeMetrics metrics;
+    MetricWeights weights;
+    for (const char* name : generator_names) {
+        auto gen = makeGenerator(name);
+        std::vector<double> values[metric_count];
+        for (uint64_t seed = from; seed < from + sample; seed++) {
+            gen->generate((uint32_t) seed, shape.width(), shape.height(), shape.startX(), shape.startY());
+            metrics.load(*gen);
+            values[0].push_back(metrics.cells());
+            values[1].push_back(metrics.deadEnds());
+            values[2].push_back(metrics.junctions());
+            values[3].push_back(std::abs(metrics.leftCells() - metrics.rightCells()));
+            values[4].push_back(metrics.averageDistance());
+            values[5].push_back(metrics.score(weights));
+        }
+        std::cout << "  " << name << "\n";
+        for (int k = 0; k < metric_count; k++) {
+            auto& v = values[k];
+            std::sort(v.begin(), v.end());
+            double mean = 0;
+            for (double x : v) {
+                mean += x;
+            }
+            mean /= v.size();
+            std::cout << "    " << std::left << std::setw(16) << metric_names[k] << std::right << v[v.size() / 10] << " / "
+                      << v[v.size() / 2] << " / " << v[(v.size() * 9) / 10] << " (" << mean << ")\n";
+        }
+    }
+}
+
+// re-rolls a size x size region at a random spot in each maze, timing only the regenerate calls
+void benchRegenerate(int size, uint64_t from, uint64_t count) {
+    MazeBuilder m(0);
+    std::mt19937 rng(size);
+    double secs = 0;
+    uint64_t kept = 0;
+    for (uint64_t seed = from; seed < from + count; seed++) {
+        m.reset((uint32_t) seed);
+        m.generate();
+        std::uniform_int_distribution<int> px(1, m.width() - 1 - size);
+        std::uniform_int_distribution<int> py(1, m.height() - 1 - size);
+        WallRect region = {px(rng), py(rng), size, size};
+        auto start = std::chrono::steady_clock::now();
+        kept += m.regenerate(region, rng()) ? 0 : 1;
+        secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::cout << "regenerate " << size << "x" << size << ": " << (secs * 1e6 / count) << " us/region, "
+              << kept << " of " << count << " kept their old corridors\n";
+}
+
+// wall clock of each phase of a chunked maze as the thread count doubles
+void benchGiant(int size, int chunk, int max_threads, int runs, uint32_t seed) {
+    ChunkedMaze m(size, size, chunk);
+    std::vector<int> counts;
+    for (int t = 1; t < max_threads; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+    double serial = 0;
+    for (int t : counts) {
+        ChunkTimes best;
+        double best_total = 0;
+        for (int i = 0; i < runs; i++) {
+            m.generate(seed, t);
+            auto& r = m.times();
+            double total = r.carve + r.stitch + r.fill + r.seams;
+            if ((i == 0) || (total < best_total)) {
+                best = r;
+                best_total = total;
+            }
+        }
+        if (t == 1) {
+            serial = best_total;
+        }
+        std::cout << "giant " << size << "x" << size << " in " << m.chunks() << " chunks, " << t << " threads: " << best_total
+                  << "s (carve " << best.carve << ", stitch " << best.stitch << ", fill " << best.fill << ", seams " << best.seams
+                  << "), " << serial / std::max(best_total, 1e-9) << "x\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t from = 0;
+    uint64_t count = 100000;
+    int runs = 3;
+    int giant = 0;
+    int chunk = 64;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--from") && (i + 1 < argc)) {
+            from = std::stoull(argv[++i]);
+        } else if ((arg == "--count") && (i + 1 < argc)) {
+            count = std::max<uint64_t>(1, std::stoull(argv[++i]));
+        } else if ((arg == "--runs") && (i + 1 < argc)) {
+            runs = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--giant") && (i + 1 < argc)) {
+            giant = std::max(12, std::stoi(argv[++i]));
+        } else if ((arg == "--chunk") && (i + 1 < argc)) {
+            chunk = std::stoi(argv[++i]);
+        } else if ((arg == "--threads") && (i + 1 < argc)) {
+            threads = std::max(1, std::stoi(argv[++i]));
+        } else {
+            std::cerr << "usage: bench [--from N] [--count N] [--runs N]\n"
+                      << "       bench --giant N [--chunk N] [--threads T] [--runs N]\n";
+            return 2;
+        }
+    }
+    if (giant > 0) {
+        benchGiant(giant, chunk, threads, runs, (uint32_t) from);
+        return 0;
+    }
+
+    double baseline = 0;
+    for (bool symmetric : {false, true}) {
+        // best of the runs, the first one also warms the caches
+        BenchResult best;
+        for (int i = 0; i < runs; i++) {
+            BenchResult r = run(symmetric, from, count);
+            if ((i == 0) || (r.secs < best.secs)) {
+                best = r;
+            }
+        }
+        double rate = count / std::max(best.secs, 1e-9);
+        if (!symmetric) {
+            baseline = rate;
+        }
+        std::cout << (symmetric ? "symmetric:  " : "asymmetric: ") << (uint64_t) rate << " mazes/s, "
+                  << (best.secs * 1e6 / count) << " us/maze, " << (double) best.corridors / count << " corridor tiles/maze";
+        if (symmetric) {
+            std::cout << ", " << rate / baseline << "x";
+        }
+        std::cout << "\n";
+    }
+    benchGenerators(from, count, runs);
+    for (int size : {4, 8, 13, 20}) {
+        benchRegenerate(size, from, std::min<uint64_t>(count, 20000));
+    }
+    return 0;
+}
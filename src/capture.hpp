@@ -0,0 +1,378 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// frames handed off by the render thread into a fixed pool of buffers and written by a background thread,
+// a frame that finds every buffer still queued is dropped so the render loop never waits on the disk
+// the path picks the output: name.y4m is a YUV4MPEG2 stream, name.raw bare RGBA frames
+// (ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r FPS -i name.raw), anything else a pattern for numbered
+// PNGs with one integer conversion such as frames/%05d.png, numbered in the order they were written
+// the two streams run at a constant fps: each stream frame shows the last frame presented by its time,
+// so a drop or a slow present repeats the frame before and presents faster than fps are skipped.
+// PNGs are every frame that wasn't dropped, one file each with no timing
+
+enum captureFormat {
+    cap_png,
+    cap_y4m,
+    cap_raw
+};
+
+// RGBA rows bottom up, as glReadPixels leaves them
+struct CaptureBuffer {
+    std::vector<uint8_t> pixels;
+    std::chrono::steady_clock::time_point presented;
+};
+
+class FrameCapture {
+    captureFormat p_format = cap_png;
+    std::string p_path;
+    unsigned p_w = 0;
+    unsigned p_h = 0;
+    int p_fps = 60;
+    // a PNG pattern split around its conversion
+    std::string p_prefix;
+    std::string p_suffix;
+    size_t p_pad = 0;
+    char p_pad_char = ' ';
+    std::ofstream p_out;
+    std::vector<std::unique_ptr<CaptureBuffer>> p_pool;
+    std::thread p_encoder;
+
+    std::mutex p_mutex;
+    std::condition_variable p_cv;
+    std::vector<CaptureBuffer*> p_free;
+    std::deque<CaptureBuffer*> p_ready;
+    bool p_stop = false;
+    bool p_running = false;
+
+    // written by the render thread only
+    uint64_t p_submitted = 0;
+    uint64_t p_dropped = 0;
+    FrameTimes p_overhead = FrameTimes(4096);
+    // written by the encoder thread only, read after stop
+    uint64_t p_written = 0;
+    uint64_t p_repeated = 0;
+    uint64_t p_skipped = 0;
+    uint64_t p_failed = 0;
+    double p_encode_secs = 0;
+    sf::Image p_image;
+    std::vector<uint8_t> p_frame;
+    // the stream formats hold on to the newest frame until the next one says how long it was shown
+    CaptureBuffer* p_held = nullptr;
+    std::chrono::steady_clock::time_point p_first;
+    uint64_t p_slots = 0;
+
+    static bool endsWith(const std::string& s, const char* tail) {
+        std::string t(tail);
+        return (s.size() >= t.size()) && (s.compare(s.size() - t.size(), t.size(), t) == 0);
+    }
+
+    // %d, %i or %u with an optional 0 flag, width and l or ll, and %% for a percent sign. anything else
+    // is refused here so the path is never used as a printf format
+    bool splitPattern(const std::string& path) {
+        p_prefix.clear();
+        p_suffix.clear();
+        p_pad = 0;
+        p_pad_char = ' ';
+        int conversions = 0;
+        std::string* out = &p_prefix;
+        for (size_t i = 0; i < path.size(); i++) {
+            if (path[i] != '%') {
+                *out += path[i];
+                continue;
+            }
+            if ((i + 1 < path.size()) && (path[i + 1] == '%')) {
+                *out += '%';
+                i++;
+                continue;
+            }
+            i++;
+            if ((i < path.size()) && (path[i] == '0')) {
+                p_pad_char = '0';
+                i++;
+            }
+            for (; (i < path.size()) && (path[i] >= '0') && (path[i] <= '9') && (p_pad < 100); i++) {
+                p_pad = (p_pad * 10) + (path[i] - '0');
+            }
+            for (int l = 0; (l < 2) && (i < path.size()) && (path[i] == 'l'); l++) {
+                i++;
+            }
+            if ((i >= path.size()) || ((path[i] != 'd') && (path[i] != 'i') && (path[i] != 'u')) || (++conversions > 1)) {
+                return false;
+            }
+            out = &p_suffix;
+        }
+        return conversions == 1;
+    }
+
+    std::string frameName(uint64_t n) const {
+        std::string digits = std::to_string(n);
+        if (digits.size() < p_pad) {
+            digits.insert(0, p_pad - digits.size(), p_pad_char);
+        }
+        return p_prefix + digits + p_suffix;
+    }
+
+    bool writePng(CaptureBuffer& b) {
+        p_image.create(p_w, p_h, b.pixels.data());
+        p_image.flipVertically();
+        return p_image.saveToFile(frameName(p_written));
+    }
+
+    // one stream frame into p_frame, top row first
+    void encodeFrame(const CaptureBuffer& b) {
+        const size_t stride = (size_t) p_w * 4;
+        if (p_format == cap_raw) {
+            p_frame.resize(stride * p_h);
+            for (unsigned y = 0; y < p_h; y++) {
+                std::copy_n(b.pixels.data() + ((p_h - 1 - y) * stride), stride, p_frame.data() + (y * stride));
+            }
+            return;
+        }
+        // full resolution 4:4:4 planes, BT.601 studio range
+        const char tag[] = "FRAME\n";
+        p_frame.assign(tag, tag + 6);
+        p_frame.resize(6 + ((size_t) p_w * p_h * 3));
+        uint8_t* v_out = p_frame.data() + 6;
+        for (int plane = 0; plane < 3; plane++) {
+            for (unsigned y = p_h; y-- > 0;) {
+                const uint8_t* px = b.pixels.data() + (y * stride);
+                for (unsigned x = 0; x < p_w; x++, px += 4) {
+                    int r = px[0];
+                    int g = px[1];
+                    int bl = px[2];
+                    int v;
+                    if (plane == 0) {
+                        v = (((66 * r) + (129 * g) + (25 * bl) + 128) >> 8) + 16;
+                    } else if (plane == 1) {
+                        v = (((-38 * r) - (74 * g) + (112 * bl) + 128) >> 8) + 128;
+                    } else {
+                        v = (((112 * r) - (94 * g) - (18 * bl) + 128) >> 8) + 128;
+                    }
+                    *v_out++ = (uint8_t) v;
+                }
+            }
+        }
+    }
+
+    std::chrono::steady_clock::time_point slotTime(uint64_t slot) const {
+        return p_first + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double) slot / p_fps));
+    }
+
+    // the held frame fills every stream slot that starts before until, false once the stream failed
+    bool writeHeld(std::chrono::steady_clock::time_point until) {
+        bool first = true;
+        while (slotTime(p_slots) < until) {
+            if (first) {
+                encodeFrame(*p_held);
+            }
+            p_out.write((const char*) p_frame.data(), p_frame.size());
+            if (!p_out) {
+                return false;
+            }
+            p_written++;
+            p_repeated += first ? 0 : 1;
+            p_slots++;
+            first = false;
+        }
+        p_skipped += first ? 1 : 0;
+        return true;
+    }
+
+    // returns the buffer that can go back to the pool, the stream formats keep b and hand back the one before
+    CaptureBuffer* write(CaptureBuffer* b) {
+        if (p_format == cap_png) {
+            if (writePng(*b)) {
+                p_written++;
+            } else {
+                p_failed++;
+            }
+            return b;
+        }
+        if (!p_held) {
+            p_first = b->presented;
+            p_held = b;
+            return nullptr;
+        }
+        if (!writeHeld(b->presented)) {
+            p_failed++;
+        }
+        std::swap(p_held, b);
+        return b;
+    }
+
+    // the last frame gets the one slot after the frame before it
+    void flushHeld() {
+        if (p_held) {
+            if (!writeHeld(slotTime(p_slots) + std::chrono::microseconds(500000 / p_fps))) {
+                p_failed++;
+            }
+            p_held = nullptr;
+        }
+    }
+
+    void encode() {
+        Tracer::get().setThreadName("capture");
+        for (;;) {
+            CaptureBuffer* b;
+            {
+                std::unique_lock<std::mutex> lock(p_mutex);
+                p_cv.wait(lock, [&]() {
+                    return p_stop || !p_ready.empty();
+                });
+                // the frames already handed over are still written after stop
+                if (p_ready.empty()) {
+                    lock.unlock();
+                    flushHeld();
+                    return;
+                }
+                b = p_ready.front();
+                p_ready.pop_front();
+            }
+            auto start = std::chrono::steady_clock::now();
+            CaptureBuffer* done;
+            {
+                TRACE_SCOPE("encode frame");
+                done = write(b);
+            }
+            p_encode_secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (done) {
+                std::lock_guard<std::mutex> lock(p_mutex);
+                p_free.push_back(done);
+            }
+        }
+    }
+
+public:
+    ~FrameCapture() {
+        stop();
+    }
+
+    // fps is the stream rate, unused for PNGs. false when the stream can't be opened or a PNG pattern
+    // doesn't have exactly one integer conversion
+    bool start(const std::string& path, unsigned w, unsigned h, int fps, int buffers = 8) {
+        stop();
+        p_path = path;
+        p_w = w;
+        p_h = h;
+        p_fps = std::max(1, fps);
+        p_format = endsWith(path, ".y4m") ? cap_y4m : (endsWith(path, ".raw") ? cap_raw : cap_png);
+        if ((p_format == cap_png) && !splitPattern(path)) {
+            return false;
+        }
+        if (p_format != cap_png) {
+            p_out.open(path, std::ios::binary | std::ios::trunc);
+            if (!p_out) {
+                return false;
+            }
+            if (p_format == cap_y4m) {
+                p_out << "YUV4MPEG2 W" << w << " H" << h << " F" << p_fps << ":1 Ip A1:1 C444\n";
+            }
+        }
+        p_pool.clear();
+        p_free.clear();
+        p_ready.clear();
+        // the streams hold one frame back, it gets a buffer of its own
+        int total = buffers + ((p_format == cap_png) ? 0 : 1);
+        for (int i = 0; i < total; i++) {
+            p_pool.emplace_back(new CaptureBuffer());
+            p_pool.back()->pixels.resize((size_t) w * h * 4);
+            p_free.push_back(p_pool.back().get());
+        }
+        p_submitted = 0;
+        p_dropped = 0;
+        p_written = 0;
+        p_repeated = 0;
+        p_skipped = 0;
+        p_failed = 0;
+        p_encode_secs = 0;
+        p_held = nullptr;
+        p_slots = 0;
+        p_stop = false;
+        p_running = true;
+        p_encoder = std::thread([this]() {
+            encode();
+        });
+        return true;
+    }
+
+    // writes out the queued frames and closes the stream
+    void stop() {
+        if (!p_running) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_stop = true;
+        }
+        p_cv.notify_one();
+        p_encoder.join();
+        p_out.close();
+        p_running = false;
+    }
+
+    bool running() const {
+        return p_running;
+    }
+    unsigned width() const {
+        return p_w;
+    }
+    unsigned height() const {
+        return p_h;
+    }
+
+    // a free buffer to fill, nullptr drops this frame
+    CaptureBuffer* acquire() {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        if (p_free.empty()) {
+            p_dropped++;
+            return nullptr;
+        }
+        CaptureBuffer* b = p_free.back();
+        p_free.pop_back();
+        return b;
+    }
+
+    // call right before the frame is presented, its time places it in the stream
+    void submit(CaptureBuffer* b) {
+        b->presented = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_ready.push_back(b);
+        }
+        p_cv.notify_one();
+        p_submitted++;
+    }
+
+    // render thread time spent on one frame, dropped ones included
+    void addOverhead(float ms) {
+        p_overhead.add(ms);
+    }
+
+    void report(std::ostream& out) const {
+        out << "capture " << p_path << ": " << p_written << " frames written, " << p_dropped << " dropped";
+        if (p_format != cap_png) {
+            out << ", " << p_repeated << " repeated and " << p_skipped << " skipped to keep " << p_fps << " fps";
+        }
+        if (p_failed > 0) {
+            out << ", " << p_failed << " failed to write";
+        }
+        out << "\n  render thread ms per frame over the last " << p_overhead.size() << ": p50 " << p_overhead.percentile(0.50)
+            << ", p99 " << p_overhead.percentile(0.99) << ", max " << p_overhead.percentile(1.0) << "\n";
+        if (p_submitted > 0) {
+            out << "  encoder " << (p_encode_secs * 1000 / p_submitted) << " ms per submitted frame\n";
+        }
+    }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include "maze.hpp"
+#include <cstdint>
+#include <vector>
+
+// the rules every finished maze keeps, shared by verify and search
+
+enum invariant {
+    inv_double_thickness,
+    inv_open_block,
+    inv_border,
+    inv_unfilled,
+    inv_bounds,
+    inv_wall_on_path,
+    inv_disconnected,
+    inv_diagonal,
+    inv_count
+};
+
+const char* const invariant_names[inv_count] = {
+    "double_thickness",
+    "open_2x2",
+    "border",
+    "unfilled",
+    "out_of_bounds",
+    "wall_on_path",
+    "disconnected",
+    "diagonal_touch"
+};
+
+struct Failure {
+    uint32_t seed;
+    int inv;
+    int x;
+    int y;
+};
+
+// checks a finished maze, a MazeBuilder or a ChunkedMaze, adding the first offending tile of each broken invariant to out
+template <typename Maze>
+void checkMaze(const Maze& m, uint32_t seed, std::vector<uint8_t>& cover, std::vector<int>& queue, std::vector<Failure>& out) {
+    int w = m.width();
+    int h = m.height();
+    bool found[inv_count] = {};
+    auto fail = [&](int inv, int x, int y) {
+        if (!found[inv]) {
+            found[inv] = true;
+            out.push_back({seed, inv, x, y});
+        }
+    };
+
+    // count the fill walls over each board tile
+    cover.assign(w * h, 0);
+    for (auto& r : m.rects()) {
+        if ((r.w <= 0) || (r.h <= 0) || (r.x < 0) || (r.y < 0) || (r.x + r.w > w) || (r.y + r.h > h)) {
+            fail(inv_bounds, r.x, r.y);
+            continue;
+        }
+        for (int y = r.y; y < r.y + r.h; y++) {
+            for (int x = r.x; x < r.x + r.w; x++) {
+                if ((x == 0) || (y == 0) || (x == w - 1) || (y == h - 1)) {
+                    fail(inv_border, x, y);
+                }
+                cover[(y * w) + x]++;
+            }
+        }
+    }
+
+    auto isPath = [&](int x, int y) {
+        return m.at(x, y) == cell_path;
+    };
+    auto isOpen = [&](int x, int y) {
+        return (m.at(x, y) != cell_wall) && (cover[(y * w) + x] == 0);
+    };
+    for (int y = 1; y < h - 1; y++) {
+        for (int x = 1; x < w - 1; x++) {
+            bool path = isPath(x, y);
+            bool covered = cover[(y * w) + x] != 0;
+            if (path && covered) {
+                fail(inv_wall_on_path, x, y);
+            }
+            if (!path && !covered) {
+                fail(inv_unfilled, x, y);
+            }
+            if ((x < w - 2) && (y < h - 2)) {
+                // the 2x2 corridor shapes hasDoubleThickness rejects while carving
+                if (isPath(x, y) && isPath(x + 1, y) && isPath(x, y + 1) && isPath(x + 1, y + 1)) {
+                    fail(inv_double_thickness, x, y);
+                }
+                if (isOpen(x, y) && isOpen(x + 1, y) && isOpen(x, y + 1) && isOpen(x + 1, y + 1)) {
+                    fail(inv_open_block, x, y);
+                }
+                // corridors that meet only at a corner
+                bool a = isPath(x, y);
+                bool b = isPath(x + 1, y);
+                bool c = isPath(x, y + 1);
+                bool d = isPath(x + 1, y + 1);
+                if ((a && d && !b && !c) || (b && c && !a && !d)) {
+                    fail(inv_diagonal, x, y);
+                }
+            }
+        }
+    }
+
+    // every corridor tile reachable from the start, cover doubles as the visited set
+    for (auto& c : cover) {
+        c = 0;
+    }
+    queue.clear();
+    queue.push_back((m.startY() * w) + m.startX());
+    cover[queue[0]] = 1;
+    for (size_t head = 0; head < queue.size(); head++) {
+        int u = queue[head];
+        const int next[4] = {u - w, u - 1, u + w, u + 1};
+        for (int v : next) {
+            if (!cover[v] && isPath(v % w, v / w)) {
+                cover[v] = 1;
+                queue.push_back(v);
+            }
+        }
+    }
+    for (int y = 1; y < h - 1; y++) {
+        for (int x = 1; x < w - 1; x++) {
+            if (isPath(x, y) && !cover[(y * w) + x]) {
+                fail(inv_disconnected, x, y);
+            }
+        }
+    }
+}
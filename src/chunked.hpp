@@ -0,0 +1,335 @@
+#pragma once
+#include "maze.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// one very large maze, 4096x4096 for an arena mode say, generated in chunks on several threads
+// every chunk is a MazeBuilder board of its own whose border is a one tile seam shared with the next chunk,
+// so the carving rules hold in each chunk without it seeing the others. the chunks are carved in parallel,
+// each seam gets one door per pair of neighbouring chunks, then the chunks run their fill passes in parallel
+// with the doors in place and whatever is left of the seams is walled in
+// a chunk whose walk keeps clear of a seam is carved again with other seeds, if none of them reaches it the seam
+// gets no door and generate reports the maze as failed
+// corridors never touch a board's border ring (isAlongWall and toPrune keep them off it), so the cells either
+// side of a seam are empty and a door through them can't make a 2x2 block or a diagonal touch
+
+struct ChunkTimes {
+    double carve = 0;
+    double stitch = 0;
+    double fill = 0;
+    double seams = 0;
+};
+
+class ChunkedMaze {
+    int p_w;
+    int p_h;
+    int p_gw;
+    int p_gh;
+    int p_chunk;
+    // chunk spans along each axis, a seam tile sits between neighbouring spans
+    std::vector<int> p_xs;
+    std::vector<int> p_ws;
+    std::vector<int> p_ys;
+    std::vector<int> p_hs;
+    std::vector<uint8_t> p_grid;
+    std::vector<WallRect> p_rects;
+    std::vector<std::vector<WallRect>> p_chunk_rects;
+    int p_doors = 0;
+    int p_missing = 0;
+    ChunkTimes p_times;
+
+    static void split(int length, int chunk, std::vector<int>& at, std::vector<int>& size) {
+        int n = std::max(1, (length + 1) / (chunk + 1));
+        int cells = length - (n - 1);
+        at.clear();
+        size.clear();
+        for (int i = 0, pos = 1; i < n; i++) {
+            size.push_back((cells / n) + ((i < cells % n) ? 1 : 0));
+            at.push_back(pos);
+            pos += size.back() + 1;
+        }
+    }
+
+    // chunk start tile, in chunk board coordinates
+    static int chunkStartX() {
+        return 3;
+    }
+    static int chunkStartY(int h) {
+        return (h + 1) / 2;
+    }
+
+    static uint32_t chunkSeed(uint32_t seed, int k) {
+        return seed + (uint32_t) (k + 1) * 0x9e3779b9u;
+    }
+
+    MazeBuilder& builderFor(std::unique_ptr<MazeBuilder>& b, int w, int h, uint32_t seed) {
+        if (!b || (b->width() != w + 2) || (b->height() != h + 2)) {
+            b.reset(new MazeBuilder(seed, w + 2, h + 2, chunkStartX(), chunkStartY(h)));
+        } else {
+            b->reset(seed);
+        }
+        return *b;
+    }
+
+    // runs f(builder, chunk) for every chunk, each thread keeps one builder and reuses it while the chunk size allows
+    template <typename F>
+    void forEachChunk(int threads, F f) {
+        int chunks = (int) (p_xs.size() * p_ys.size());
+        std::atomic<int> next(0);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < std::max(1, std::min(threads, chunks)); t++) {
+            workers.emplace_back([&]() {
+                std::unique_ptr<MazeBuilder> b;
+                for (int k = next++; k < chunks; k = next++) {
+                    f(b, k);
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    // a door needs a corridor next to every seam of the chunk, away from the ends as in stitch
+    bool reachesSeams(const MazeBuilder& m, int cx, int cy) const {
+        int gw = m.width() - 2;
+        int gh = m.height() - 2;
+        auto any = [&](int x0, int y0, int dx, int dy, int n) {
+            for (int i = 0; i < n; i++) {
+                if (m.at(x0 + (i * dx), y0 + (i * dy)) == cell_path) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        return ((cx == 0) || any(2, 3, 0, 1, gh - 4)) &&
+               ((cx + 1 == (int) p_xs.size()) || any(gw - 1, 3, 0, 1, gh - 4)) &&
+               ((cy == 0) || any(3, 2, 1, 0, gw - 4)) &&
+               ((cy + 1 == (int) p_ys.size()) || any(3, gh - 1, 1, 0, gw - 4));
+    }
+
+    uint8_t& cell(int x, int y) {
+        return p_grid[((y - 1) * p_gw) + (x - 1)];
+    }
+
+    // joins the corridor ending at (ax, ay) on one side of a seam to (bx, by) on the other, running along the seam
+    // tile between them when the rows (or columns) differ
+    void carveDoor(int ax, int ay, int bx, int by, bool vertical_seam) {
+        if (vertical_seam) {
+            int g = ax + 2;
+            cell(ax + 1, ay) = cell_path;
+            for (int y = std::min(ay, by); y <= std::max(ay, by); y++) {
+                cell(g, y) = cell_path;
+            }
+            cell(bx - 1, by) = cell_path;
+        } else {
+            int g = ay + 2;
+            cell(ax, ay + 1) = cell_path;
+            for (int x = std::min(ax, bx); x <= std::max(ax, bx); x++) {
+                cell(x, g) = cell_path;
+            }
+            cell(bx, by - 1) = cell_path;
+        }
+        p_doors++;
+    }
+
+    // one door across the seam at column (or row) g, within the span [from, from + len) of the other axis
+    // doors keep off the first and last corridor row (or column) of the span, where a door from the crossing
+    // seam could close off a corner of the border ring that no fill pass reaches
+    void stitch(int g, int from, int len, bool vertical_seam, std::mt19937& rng, std::vector<int>& a, std::vector<int>& b) {
+        a.clear();
+        b.clear();
+        for (int i = from + 2; i < from + len - 2; i++) {
+            if ((vertical_seam ? cell(g - 2, i) : cell(i, g - 2)) == cell_path) {
+                a.push_back(i);
+            }
+            if ((vertical_seam ? cell(g + 2, i) : cell(i, g + 2)) == cell_path) {
+                b.push_back(i);
+            }
+        }
+        if (a.empty() || b.empty()) {
+            p_missing++;
+            return;
+        }
+        int ia = a[std::uniform_int_distribution<int>(0, (int) a.size() - 1)(rng)];
+        // the nearest corridor on the other side keeps the run along the seam short
+        auto it = std::lower_bound(b.begin(), b.end(), ia);
+        int ib = (it == b.end()) ? b.back() : *it;
+        if ((it != b.begin()) && ((it == b.end()) || (ia - *(it - 1) < *it - ia))) {
+            ib = *(it - 1);
+        }
+        if (vertical_seam) {
+            carveDoor(g - 2, ia, g + 2, ib, true);
+        } else {
+            carveDoor(ia, g - 2, ib, g + 2, false);
+        }
+    }
+
+    void wallRun(int x, int y, int w, int h) {
+        p_rects.push_back({x, y, w, h});
+        for (int j = y; j < y + h; j++) {
+            for (int i = x; i < x + w; i++) {
+                cell(i, j) = cell_wall;
+            }
+        }
+    }
+
+public:
+    // w and h are the board size including the border, chunk the interior size each chunk aims for
+    // the smaller the chunks the more often one has to be carved again to reach all its seams
+    ChunkedMaze(int w, int h, int chunk = 64)
+        : p_w(w), p_h(h), p_gw(w - 2), p_gh(h - 2), p_chunk(std::max(chunk, 16)) {
+        split(p_gw, p_chunk, p_xs, p_ws);
+        split(p_gh, p_chunk, p_ys, p_hs);
+    }
+
+    // false when a seam was left without a door, the chunks past it may then be cut off from the start
+    bool generate(uint32_t seed, int threads) {
+        typedef std::chrono::steady_clock clock;
+        auto secs = [](clock::time_point a, clock::time_point b) {
+            return std::chrono::duration<double>(b - a).count();
+        };
+        int cols = (int) p_xs.size();
+        p_grid.assign((size_t) p_gw * p_gh, cell_empty);
+        p_rects.clear();
+        p_chunk_rects.resize(p_xs.size() * p_ys.size());
+        p_doors = 0;
+        p_missing = 0;
+
+        auto t0 = clock::now();
+        forEachChunk(threads, [&](std::unique_ptr<MazeBuilder>& b, int k) {
+            int cx = k % cols;
+            int cy = k / cols;
+            // the walk now and then stays clear of a seam, that chunk is carved again with another seed
+            MazeBuilder* m = nullptr;
+            for (uint32_t attempt = 0; attempt < 16; attempt++) {
+                m = &builderFor(b, p_ws[cx], p_hs[cy], chunkSeed(seed, k) + (attempt * 0x85ebca6bu));
+                m->carveAll();
+                if (reachesSeams(*m, cx, cy)) {
+                    break;
+                }
+            }
+            for (int y = 0; y < p_hs[cy]; y++) {
+                auto row = m->grid().begin() + (y * p_ws[cx]);
+                std::copy(row, row + p_ws[cx], p_grid.begin() + ((p_ys[cy] - 1 + y) * p_gw) + (p_xs[cx] - 1));
+            }
+        });
+
+        auto t1 = clock::now();
+        std::mt19937 rng(seed);
+        std::vector<int> a;
+        std::vector<int> b;
+        for (size_t cy = 0; cy < p_ys.size(); cy++) {
+            for (size_t cx = 0; cx + 1 < p_xs.size(); cx++) {
+                stitch(p_xs[cx + 1] - 1, p_ys[cy], p_hs[cy], true, rng, a, b);
+            }
+        }
+        for (size_t cy = 0; cy + 1 < p_ys.size(); cy++) {
+            for (size_t cx = 0; cx < p_xs.size(); cx++) {
+                stitch(p_ys[cy + 1] - 1, p_xs[cx], p_ws[cx], false, rng, a, b);
+            }
+        }
+
+        auto t2 = clock::now();
+        forEachChunk(threads, [&](std::unique_ptr<MazeBuilder>& b, int k) {
+            int cx = k % cols;
+            int cy = k / cols;
+            MazeBuilder& m = builderFor(b, p_ws[cx], p_hs[cy], 0);
+            uint8_t* origin = &p_grid[((p_ys[cy] - 1) * p_gw) + (p_xs[cx] - 1)];
+            m.loadCorridors(origin, p_gw);
+            m.generate();
+            for (int y = 0; y < p_hs[cy]; y++) {
+                auto row = m.grid().begin() + (y * p_ws[cx]);
+                std::copy(row, row + p_ws[cx], origin + (y * p_gw));
+            }
+            auto& out = p_chunk_rects[k];
+            out.clear();
+            for (auto& r : m.rects()) {
+                out.push_back({r.x + p_xs[cx] - 1, r.y + p_ys[cy] - 1, r.w, r.h});
+            }
+        });
+
+        auto t3 = clock::now();
+        for (auto& rs : p_chunk_rects) {
+            p_rects.insert(p_rects.end(), rs.begin(), rs.end());
+        }
+        // seam rows run the full width through the crossings, seam columns stop short of them
+        for (size_t cy = 0; cy + 1 < p_ys.size(); cy++) {
+            int g = p_ys[cy + 1] - 1;
+            for (int x = 1; x <= p_gw;) {
+                int run = 0;
+                while ((x + run <= p_gw) && (cell(x + run, g) == cell_empty)) {
+                    run++;
+                }
+                if (run > 0) {
+                    wallRun(x, g, run, 1);
+                }
+                x += std::max(run, 1);
+            }
+        }
+        for (size_t cx = 0; cx + 1 < p_xs.size(); cx++) {
+            int g = p_xs[cx + 1] - 1;
+            for (size_t cy = 0; cy < p_ys.size(); cy++) {
+                int end = p_ys[cy] + p_hs[cy];
+                for (int y = p_ys[cy]; y < end;) {
+                    int run = 0;
+                    while ((y + run < end) && (cell(g, y + run) == cell_empty)) {
+                        run++;
+                    }
+                    if (run > 0) {
+                        wallRun(g, y, 1, run);
+                    }
+                    y += std::max(run, 1);
+                }
+            }
+        }
+        auto t4 = clock::now();
+        p_times = {secs(t0, t1), secs(t1, t2), secs(t2, t3), secs(t3, t4)};
+        return p_missing == 0;
+    }
+
+    int width() const {
+        return p_w;
+    }
+    int height() const {
+        return p_h;
+    }
+    // the first chunk's start tile, every corridor is reachable from it
+    int startX() const {
+        return p_xs[0] - 1 + chunkStartX();
+    }
+    int startY() const {
+        return p_ys[0] - 1 + chunkStartY(p_hs[0]);
+    }
+    int chunks() const {
+        return (int) (p_xs.size() * p_ys.size());
+    }
+    int doors() const {
+        return p_doors;
+    }
+    // seams where one side still had no corridor next to it after re-carving, generate fails when there are any
+    int missingDoors() const {
+        return p_missing;
+    }
+    const ChunkTimes& times() const {
+        return p_times;
+    }
+    const std::vector<WallRect>& rects() const {
+        return p_rects;
+    }
+    const std::vector<uint8_t>& grid() const {
+        return p_grid;
+    }
+    cellType at(int x, int y) const {
+        if ((x < 1) || (y < 1) || (x > p_gw) || (y > p_gh)) {
+            return cell_wall;
+        }
+        return (cellType) p_grid[((y - 1) * p_gw) + (x - 1)];
+    }
+};
@@ -0,0 +1,436 @@
+#include <SFML/Graphics.hpp>
+#include "generator.hpp"
+#include "maze.hpp"
+#include "trace.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// scrollable grid of finished mazes for reviewing generator changes
+// usage: gallery [--from SEED] [--count N] [--corpus FILE] [--cols N] [--symmetric] [--threads N]
+//                [--generator walk|pieces]
+// --generator picks the strategy from generator.hpp, --symmetric only applies to the walk
+// a corpus is a text file with a seed at the start of each line (verify_failures.txt works), # starts a comment
+// mouse wheel or arrow keys scroll, ctrl + wheel or +/- zoom, page up/down, home and end jump
+//
+// mazes are generated in pages of rows by background threads, each page is packed into one vertex buffer
+// and drawn with a single call, pages around the visible rows are loaded ahead and distant ones dropped
+
+const int gap = 2;          // tiles between neighbouring mazes
+const int page_rows = 10;
+
+struct GalleryPage {
+    int index = 0;
+    std::vector<sf::Vertex> verts;
+};
+
+class PageLoader {
+    std::vector<uint32_t> p_seeds;
+    int p_cols;
+    bool p_symmetric;
+    std::string p_generator;
+    std::vector<std::thread> p_workers;
+    std::mutex p_mutex;
+    std::condition_variable p_cv;
+    std::deque<int> p_wanted;
+    std::set<int> p_queued;         // wanted or being built, so a page is never built twice at once
+    std::vector<GalleryPage> p_ready;
+    bool p_stop = false;
+
+    static void quad(std::vector<sf::Vertex>& out, float x, float y, float w, float h, sf::Color c) {
+        out.emplace_back(sf::Vector2f(x, y), c);
+        out.emplace_back(sf::Vector2f(x + w, y), c);
+        out.emplace_back(sf::Vector2f(x + w, y + h), c);
+        out.emplace_back(sf::Vector2f(x, y + h), c);
+    }
+
+    void build(MazeGenerator& m, const MazeBuilder& shape, GalleryPage& page) {
+        const sf::Color border(144, 238, 144);
+        const sf::Color fill(210, 4, 45);
+        size_t first = (size_t) page.index * p_cols * page_rows;
+        size_t last = std::min(p_seeds.size(), first + ((size_t) p_cols * page_rows));
+        for (size_t i = first; i < last; i++) {
+            m.generate(p_seeds[i], shape.width(), shape.height(), shape.startX(), shape.startY());
+            float ox = (float) ((i % p_cols) * (m.width() + gap));
+            float oy = (float) ((i / p_cols) * (m.height() + gap));
+            float w = (float) m.width();
+            float h = (float) m.height();
+            quad(page.verts, ox, oy, w, 1.f, border);
+            quad(page.verts, ox, oy + h - 1.f, w, 1.f, border);
+            quad(page.verts, ox, oy + 1.f, 1.f, h - 2.f, border);
+            quad(page.verts, ox + w - 1.f, oy + 1.f, 1.f, h - 2.f, border);
+            for (auto& r : m.rects()) {
+                quad(page.verts, ox + r.x, oy + r.y, (float) r.w, (float) r.h, fill);
+            }
+        }
+    }
+
+    void work() {
+        MazeBuilder shape(0);
+        auto m = makeGenerator(p_generator, p_symmetric);
+        for (;;) {
+            GalleryPage page;
+            {
+                std::unique_lock<std::mutex> lock(p_mutex);
+                p_cv.wait(lock, [&]() {
+                    return p_stop || !p_wanted.empty();
+                });
+                if (p_stop) {
+                    return;
+                }
+                page.index = p_wanted.front();
+                p_wanted.pop_front();
+            }
+            {
+                TRACE_SCOPE("build page");
+                build(*m, shape, page);
+            }
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_ready.push_back(std::move(page));
+        }
+    }
+
+public:
+    PageLoader(std::vector<uint32_t> seeds, int cols, bool symmetric, const std::string& generator, int threads)
+        : p_seeds(std::move(seeds)), p_cols(cols), p_symmetric(symmetric), p_generator(generator) {
+        for (int i = 0; i < threads; i++) {
+            p_workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+    ~PageLoader() {
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_stop = true;
+        }
+        p_cv.notify_all();
+        for (auto& w : p_workers) {
+            w.join();
+        }
+    }
+
+    int pages() const {
+        return (int) ((p_seeds.size() + ((size_t) p_cols * page_rows) - 1) / ((size_t) p_cols * page_rows));
+    }
+    size_t mazes() const {
+        return p_seeds.size();
+    }
+    uint32_t seed(size_t i) const {
+        return p_seeds[i];
+    }
+
+    // pages requested most recently are built first, the view has usually moved on from older requests
+    void want(int page) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        if ((page < 0) || (page >= pages()) || !p_queued.insert(page).second) {
+            return;
+        }
+        p_wanted.push_front(page);
+        p_cv.notify_one();
+    }
+
+    // drops queued pages that have scrolled out of range before anyone starts on them
+    void cancelOutside(int lo, int hi) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        for (auto it = p_wanted.begin(); it != p_wanted.end();) {
+            if ((*it < lo) || (*it > hi)) {
+                p_queued.erase(*it);
+                it = p_wanted.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    bool take(GalleryPage& out) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        if (p_ready.empty()) {
+            return false;
+        }
+        out = std::move(p_ready.back());
+        p_ready.pop_back();
+        p_queued.erase(out.index);
+        return true;
+    }
+};
+
+// a page uploaded for drawing, kept in client memory as well when vertex buffers are unavailable
+struct LoadedPage {
+    sf::VertexBuffer buffer = sf::VertexBuffer(sf::Quads, sf::VertexBuffer::Static);
+    std::vector<sf::Vertex> verts;
+};
+
+class Gallery {
+    sf::RenderWindow p_window;
+    PageLoader& p_loader;
+    int p_cols;
+    float p_cell_w;
+    float p_cell_h;
+    sf::View p_view;
+    float p_zoom = 1.f;
+    std::map<int, std::unique_ptr<LoadedPage>> p_loaded;
+    bool p_use_buffers = sf::VertexBuffer::isAvailable();
+    FrameTimes p_frame_times;
+
+    int pageAt(float y) const {
+        return (int) (y / (p_cell_h * page_rows));
+    }
+
+    void clampView() {
+        sf::Vector2f c = p_view.getCenter();
+        sf::Vector2f s = p_view.getSize();
+        float rows = (float) ((p_loader.mazes() + p_cols - 1) / p_cols);
+        float max_y = std::max(s.y / 2.f, (rows * p_cell_h) - (s.y / 2.f));
+        c.y = std::max(s.y / 2.f, std::min(c.y, max_y));
+        c.x = std::max(0.f, std::min(c.x, p_cols * p_cell_w));
+        p_view.setCenter(c);
+    }
+
+    void zoom(float factor) {
+        float z = std::max(0.05f, std::min(p_zoom * factor, 20.f));
+        p_view.zoom(z / p_zoom);
+        p_zoom = z;
+        clampView();
+    }
+
+    void scroll(float rows) {
+        p_view.move(0.f, rows * p_cell_h);
+        clampView();
+    }
+
+    void handleEvent(const sf::Event& event) {
+        if (event.type == sf::Event::Closed) {
+            p_window.close();
+        } else if (event.type == sf::Event::Resized) {
+            sf::Vector2f center = p_view.getCenter();
+            p_view.setSize((float) event.size.width * p_zoom, (float) event.size.height * p_zoom);
+            p_view.setCenter(center);
+            clampView();
+        } else if (event.type == sf::Event::MouseWheelScrolled) {
+            bool ctrl = sf::Keyboard::isKeyPressed(sf::Keyboard::LControl) || sf::Keyboard::isKeyPressed(sf::Keyboard::RControl);
+            if (ctrl) {
+                zoom((event.mouseWheelScroll.delta > 0) ? 0.8f : 1.25f);
+            } else {
+                scroll(-event.mouseWheelScroll.delta);
+            }
+        } else if (event.type == sf::Event::KeyPressed) {
+            float page = p_view.getSize().y / p_cell_h;
+            switch (event.key.code) {
+                case sf::Keyboard::Up: scroll(-1.f); break;
+                case sf::Keyboard::Down: scroll(1.f); break;
+                case sf::Keyboard::Left: p_view.move(-p_cell_w, 0.f); clampView(); break;
+                case sf::Keyboard::Right: p_view.move(p_cell_w, 0.f); clampView(); break;
+                case sf::Keyboard::PageUp: scroll(-page); break;
+                case sf::Keyboard::PageDown: scroll(page); break;
+                case sf::Keyboard::Home: scroll(-1e9f); break;
+                case sf::Keyboard::End: scroll(1e9f); break;
+                case sf::Keyboard::Add:
+                case sf::Keyboard::Equal: zoom(0.8f); break;
+                case sf::Keyboard::Subtract:
+                case sf::Keyboard::Hyphen: zoom(1.25f); break;
+                default: break;
+            }
+        }
+    }
+
+    // asks for the visible pages and one screen either side, forgets pages further away than that
+    void streamPages(int first, int last) {
+        int span = last - first + 1;
+        int keep_lo = first - span;
+        int keep_hi = last + span;
+        p_loader.cancelOutside(keep_lo, keep_hi);
+        for (int p = keep_hi; p >= keep_lo; p--) {
+            if ((p < first) || (p > last)) {
+                if (p_loaded.find(p) == p_loaded.end()) {
+                    p_loader.want(p);
+                }
+            }
+        }
+        // the visible pages go in last so they are built first
+        for (int p = last; p >= first; p--) {
+            if (p_loaded.find(p) == p_loaded.end()) {
+                p_loader.want(p);
+            }
+        }
+        for (auto it = p_loaded.begin(); it != p_loaded.end();) {
+            if ((it->first < keep_lo) || (it->first > keep_hi)) {
+                it = p_loaded.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // a couple of uploads per frame keeps a burst of finished pages from causing a hitch
+        GalleryPage page;
+        for (int uploads = 0; (uploads < 2) && p_loader.take(page); uploads++) {
+            if ((page.index < keep_lo) || (page.index > keep_hi)) {
+                continue;
+            }
+            TRACE_SCOPE("upload page");
+            auto loaded = std::unique_ptr<LoadedPage>(new LoadedPage());
+            if (p_use_buffers && loaded->buffer.create(page.verts.size()) && loaded->buffer.update(page.verts.data())) {
+                page.verts.clear();
+            } else {
+                p_use_buffers = false;
+                loaded->verts = std::move(page.verts);
+            }
+            p_loaded[page.index] = std::move(loaded);
+        }
+    }
+
+    void updateTitle(int first, int last, std::chrono::steady_clock::time_point& title_at) {
+        auto now = std::chrono::steady_clock::now();
+        if (now < title_at) {
+            return;
+        }
+        title_at = now + std::chrono::milliseconds(500);
+        size_t lo = std::min(p_loader.mazes() - 1, (size_t) first * p_cols * page_rows);
+        size_t hi = std::min(p_loader.mazes() - 1, ((size_t) (last + 1) * p_cols * page_rows) - 1);
+        float p50 = p_frame_times.percentile(0.50);
+        char title[160];
+        snprintf(title, sizeof(title), "gallery  seeds %u..%u  %zu pages loaded  %.0f fps  p99 %.1fms",
+                 p_loader.seed(lo), p_loader.seed(hi), p_loaded.size(), (p50 > 0.f) ? 1000.f / p50 : 0.f,
+                 p_frame_times.percentile(0.99));
+        p_window.setTitle(title);
+    }
+
+public:
+    Gallery(PageLoader& loader, int cols, int w, int h)
+        : p_loader(loader), p_cols(cols), p_cell_w((float) (w + gap)), p_cell_h((float) (h + gap)) {
+        p_window.create(sf::VideoMode(1280, 960), "gallery");
+        p_window.setVerticalSyncEnabled(true);
+        // the whole row fits across the window to start with
+        p_zoom = (cols * p_cell_w) / 1280.f;
+        p_view.setSize(1280.f * p_zoom, 960.f * p_zoom);
+        p_view.setCenter(cols * p_cell_w / 2.f, 960.f * p_zoom / 2.f);
+    }
+
+    void run() {
+        auto last_frame = std::chrono::steady_clock::now();
+        auto title_at = last_frame;
+        while (p_window.isOpen()) {
+            TRACE_SCOPE("frame");
+            for (auto event = sf::Event{}; p_window.pollEvent(event);) {
+                handleEvent(event);
+            }
+            float top = p_view.getCenter().y - (p_view.getSize().y / 2.f);
+            float bottom = p_view.getCenter().y + (p_view.getSize().y / 2.f);
+            int first = std::max(0, pageAt(top));
+            int last = std::min(p_loader.pages() - 1, pageAt(bottom));
+            streamPages(first, last);
+
+            p_window.clear();
+            p_window.setView(p_view);
+            for (int p = first; p <= last; p++) {
+                auto it = p_loaded.find(p);
+                if (it == p_loaded.end()) {
+                    continue;
+                }
+                if (p_use_buffers) {
+                    p_window.draw(it->second->buffer);
+                } else {
+                    p_window.draw(it->second->verts.data(), it->second->verts.size(), sf::Quads);
+                }
+            }
+            p_window.display();
+
+            auto now = std::chrono::steady_clock::now();
+            p_frame_times.add(std::chrono::duration<float, std::milli>(now - last_frame).count());
+            last_frame = now;
+            updateTitle(first, last, title_at);
+        }
+    }
+};
+
+bool readCorpus(const std::string& path, std::vector<uint32_t>& seeds) {
+    std::ifstream f(path);
+    if (!f) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream in(line);
+        uint64_t seed;
+        if ((line.empty()) || (line[0] == '#') || !(in >> seed)) {
+            continue;
+        }
+        // verify writes one line per failed invariant, show each maze once
+        if (seeds.empty() || (seeds.back() != (uint32_t) seed)) {
+            seeds.push_back((uint32_t) seed);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t from = 0;
+    uint64_t count = 4000;
+    std::string corpus_path;
+    int cols = 20;
+    bool symmetric = false;
+    std::string generator = "walk";
+    int threads = std::max(1, (int) std::thread::hardware_concurrency() - 1);
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--from") && (i + 1 < argc)) {
+            from = std::stoull(argv[++i]);
+        } else if ((arg == "--count") && (i + 1 < argc)) {
+            count = std::stoull(argv[++i]);
+        } else if ((arg == "--corpus") && (i + 1 < argc)) {
+            corpus_path = argv[++i];
+        } else if ((arg == "--cols") && (i + 1 < argc)) {
+            cols = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--threads") && (i + 1 < argc)) {
+            threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--symmetric") {
+            symmetric = true;
+        } else if ((arg == "--generator") && (i + 1 < argc)) {
+            generator = argv[++i];
+        } else {
+            std::cerr << "usage: gallery [--from SEED] [--count N] [--corpus FILE] [--cols N] [--symmetric] [--threads N]\n"
+                      << "               [--generator walk|pieces]\n";
+            return 2;
+        }
+    }
+    if (!makeGenerator(generator)) {
+        std::cerr << "unknown generator " << generator << "\n";
+        return 2;
+    }
+    if (symmetric && (generator != "walk")) {
+        std::cerr << "--symmetric needs the walk generator\n";
+        return 2;
+    }
+
+    std::vector<uint32_t> seeds;
+    if (!corpus_path.empty()) {
+        if (!readCorpus(corpus_path, seeds)) {
+            std::cerr << "could not read corpus " << corpus_path << "\n";
+            return 1;
+        }
+    } else {
+        for (uint64_t s = from; s < from + count; s++) {
+            seeds.push_back((uint32_t) s);
+        }
+    }
+    if (seeds.empty()) {
+        std::cerr << "no mazes to show\n";
+        return 1;
+    }
+
+    MazeBuilder shape(0);
+    PageLoader loader(std::move(seeds), cols, symmetric, generator, threads);
+    Gallery gallery(loader, cols, shape.width(), shape.height());
+    gallery.run();
+    return 0;
+}
@@ -0,0 +1,415 @@
+#pragma once
+#include "maze.hpp"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// whole-maze generation strategies: a seed and the board size go in, the corridor grid and the fill
+// walls come out in the same layout MazeBuilder uses, so the tools and the game can take either
+
+class MazeGenerator {
+protected:
+    int p_w = 0;
+    int p_h = 0;
+    int p_start_x = 0;
+    int p_start_y = 0;
+
+public:
+    virtual ~MazeGenerator() {}
+
+    virtual const char* name() const = 0;
+    // the start tile is a corridor in every maze
+    virtual void generate(uint32_t seed, int w, int h, int start_x, int start_y) = 0;
+    virtual const std::vector<uint8_t>& grid() const = 0;
+    virtual const std::vector<WallRect>& rects() const = 0;
+
+    void generate(uint32_t seed) {
+        generate(seed, p_w, p_h, p_start_x, p_start_y);
+    }
+
+    int width() const {
+        return p_w;
+    }
+    int height() const {
+        return p_h;
+    }
+    int startX() const {
+        return p_start_x;
+    }
+    int startY() const {
+        return p_start_y;
+    }
+    // cell type at a board position, the border and beyond count as wall
+    cellType at(int x, int y) const {
+        if ((x < 1) || (y < 1) || (x > p_w - 2) || (y > p_h - 2)) {
+            return cell_wall;
+        }
+        return (cellType) grid()[((y - 1) * (p_w - 2)) + (x - 1)];
+    }
+};
+
+// the corridor walk and fill passes of MazeBuilder, run to the end
+class WalkGenerator : public MazeGenerator {
+    std::unique_ptr<MazeBuilder> p_builder;
+    bool p_symmetric = false;
+
+public:
+    const char* name() const override {
+        return "walk";
+    }
+    // takes effect from the next generate
+    void setSymmetric(bool symmetric) {
+        p_symmetric = symmetric;
+    }
+    void generate(uint32_t seed, int w, int h, int start_x, int start_y) override {
+        // the builder keeps its buffers between mazes of the same shape
+        if (!p_builder || (w != p_w) || (h != p_h) || (start_x != p_start_x) || (start_y != p_start_y)) {
+            p_builder.reset(new MazeBuilder(seed, w, h, start_x, start_y));
+        }
+        p_w = w;
+        p_h = h;
+        p_start_x = start_x;
+        p_start_y = start_y;
+        p_builder->setSymmetric(p_symmetric);
+        p_builder->reset(seed);
+        p_builder->generate();
+    }
+    const std::vector<uint8_t>& grid() const override {
+        return p_builder->grid();
+    }
+    const std::vector<WallRect>& rects() const override {
+        return p_builder->rects();
+    }
+    MazeBuilder& builder() {
+        return *p_builder;
+    }
+};
+
+// tiles a coarse lattice of wall blocks with polyominoes and keeps the 1 tile gaps between different
+// pieces as corridors, so every corridor runs along a piece outline: no dead ends, no 2x2 corridor,
+// and connected because the outlines of a tiling are
+// each axis is split into blocks of about 3 tiles with a corridor line between neighbours and a frame
+// of lines along the border, one row line goes through the start tile and no piece may bridge the gap
+// it sits in
+class PieceGenerator : public MazeGenerator {
+    // a piece in coarse cells, bit c of rows[r] set when it covers column c of row r, the anchor is
+    // the column of its leftmost cell in the top row, which the scan lines up with the first free cell
+    struct Piece {
+        std::array<uint64_t, 4> rows;
+        int h;
+        int w;
+        int anchor;
+        int weight;
+    };
+    // a piece shifted to one coarse column, rows empty when it doesn't fit
+    struct Placement {
+        std::array<uint64_t, 4> rows;
+        int h;
+    };
+
+    std::vector<Piece> p_pieces;
+    std::vector<int> p_weights;         // running sum over p_pieces
+    std::vector<Placement> p_masks;     // p_pieces.size() x p_cw, rebuilt when the coarse width changes
+    std::vector<int> p_block_x;         // first tile and size of each coarse column and row
+    std::vector<int> p_block_w;
+    std::vector<int> p_block_y;
+    std::vector<int> p_block_h;
+    int p_cw = 0;
+    int p_ch = 0;
+    int p_masks_cw = -1;
+    // the coarse cells above and below the start, which stay apart, -1 when the start is on the frame
+    int p_cut_row = -1;
+    int p_cut_col = 0;
+    // a start right next to the border moves the frame line onto it and walls off the row outside
+    bool p_strip_top = false;
+    bool p_strip_bottom = false;
+    std::vector<uint64_t> p_occupied;
+    std::vector<int> p_label;
+    std::vector<uint8_t> p_grid;
+    std::vector<WallRect> p_rects;
+    std::minstd_rand p_rng;     // seeded per maze, the twister's seeding would cost more than the tiling
+
+    // shapes as rows of '#', every rotation and reflection is added once
+    void addShape(std::vector<std::string> shape, int weight) {
+        for (int flip = 0; flip < 2; flip++) {
+            for (int turn = 0; turn < 4; turn++) {
+                Piece p = {{0, 0, 0, 0}, (int) shape.size(), (int) shape[0].size(), -1, weight};
+                for (int r = 0; r < p.h; r++) {
+                    for (int c = 0; c < p.w; c++) {
+                        if (shape[r][c] == '#') {
+                            p.rows[r] |= uint64_t(1) << c;
+                            if ((r == 0) && (p.anchor < 0)) {
+                                p.anchor = c;
+                            }
+                        }
+                    }
+                }
+                bool seen = false;
+                for (auto& q : p_pieces) {
+                    seen = seen || ((q.rows == p.rows) && (q.h == p.h));
+                }
+                if (!seen) {
+                    p_pieces.push_back(p);
+                }
+                // quarter turn clockwise
+                std::vector<std::string> turned(shape[0].size(), std::string(shape.size(), '.'));
+                for (size_t r = 0; r < shape.size(); r++) {
+                    for (size_t c = 0; c < shape[0].size(); c++) {
+                        turned[c][shape.size() - 1 - r] = shape[r][c];
+                    }
+                }
+                shape = turned;
+            }
+            for (auto& row : shape) {
+                std::reverse(row.begin(), row.end());
+            }
+        }
+    }
+
+    void buildMasks() {
+        p_masks.assign(p_pieces.size() * p_cw, Placement{{0, 0, 0, 0}, 0});
+        for (size_t i = 0; i < p_pieces.size(); i++) {
+            auto& p = p_pieces[i];
+            for (int c = p.anchor; c + p.w - p.anchor <= p_cw; c++) {
+                auto& m = p_masks[(i * p_cw) + c];
+                m.h = p.h;
+                for (int r = 0; r < p.h; r++) {
+                    m.rows[r] = p.rows[r] << (c - p.anchor);
+                }
+            }
+        }
+        p_masks_cw = p_cw;
+    }
+
+    // block spans along one axis of g interior tiles between frame lines at tile 1 and tile g, with
+    // another line at line when that leaves blocks on both sides of it. blocks grow past 3 tiles when
+    // more than max_blocks would be needed
+    static void split(int g, int line, std::vector<int>& start, std::vector<int>& size, int max_blocks = INT_MAX) {
+        start.clear();
+        size.clear();
+        int lo = (line == 2) ? 2 : 1;
+        int hi = (line == g - 1) ? g - 1 : g;
+        int lines[3] = {lo, line, hi};
+        int count = 3;
+        if ((line < lo + 2) || (line > hi - 2)) {
+            lines[1] = hi;
+            count = 2;
+        }
+        for (int i = 0; i + 1 < count; i++) {
+            int first = lines[i] + 1;
+            int n = lines[i + 1] - first;
+            int k = std::max(1, std::min((n + 1) / 4, max_blocks));
+            int tiles = n - (k - 1);
+            for (int b = 0; b < k; b++) {
+                // the wider blocks go last
+                int s = (tiles / k) + ((b >= k - (tiles % k)) ? 1 : 0);
+                start.push_back(first);
+                size.push_back(s);
+                first += s + 1;
+            }
+        }
+    }
+
+    // index of the block that ends right before the corridor line at tile t, -1 when t isn't on one
+    static int blockBefore(const std::vector<int>& start, const std::vector<int>& size, int t) {
+        for (size_t i = 0; i + 1 < start.size(); i++) {
+            if (start[i] + size[i] == t) {
+                return (int) i;
+            }
+        }
+        return -1;
+    }
+    static int blockAt(const std::vector<int>& start, const std::vector<int>& size, int t) {
+        for (size_t i = 0; i < start.size(); i++) {
+            if ((t >= start[i]) && (t < start[i] + size[i])) {
+                return (int) i;
+            }
+        }
+        return -1;
+    }
+
+    bool fits(const Placement& m, int row) const {
+        if ((m.h == 0) || (row + m.h > p_ch)) {
+            return false;
+        }
+        for (int r = 0; r < m.h; r++) {
+            if (p_occupied[row + r] & m.rows[r]) {
+                return false;
+            }
+        }
+        if ((p_cut_row < row) || (p_cut_row + 1 >= row + m.h)) {
+            return true;
+        }
+        return !((m.rows[p_cut_row - row] & m.rows[p_cut_row + 1 - row]) >> p_cut_col & 1);
+    }
+
+    void place(const Placement& m, int row, int label) {
+        for (int r = 0; r < m.h; r++) {
+            p_occupied[row + r] |= m.rows[r];
+            for (uint64_t bits = m.rows[r]; bits != 0; bits &= bits - 1) {
+                int c = 0;
+                while (!((bits >> c) & 1)) {
+                    c++;
+                }
+                p_label[((row + r) * p_cw) + c] = label;
+            }
+        }
+    }
+
+    void tile() {
+        const uint64_t full = (p_cw == 64) ? ~uint64_t(0) : ((uint64_t(1) << p_cw) - 1);
+        p_occupied.assign(p_ch, 0);
+        p_label.assign(p_cw * p_ch, -1);
+        std::uniform_int_distribution<int> pick(0, p_weights.back() - 1);
+        int labels = 0;
+        for (int r = 0; r < p_ch; r++) {
+            while (p_occupied[r] != full) {
+                int c = 0;
+                while ((p_occupied[r] >> c) & 1) {
+                    c++;
+                }
+                // a few random pieces, then a single block, which always fits
+                bool placed = false;
+                for (int attempt = 0; (attempt < 6) && !placed; attempt++) {
+                    int roll = pick(p_rng);
+                    size_t i = std::upper_bound(p_weights.begin(), p_weights.end(), roll) - p_weights.begin();
+                    auto& m = p_masks[(i * p_cw) + c];
+                    if (fits(m, r)) {
+                        place(m, r, labels++);
+                        placed = true;
+                    }
+                }
+                if (!placed) {
+                    Placement single = {{uint64_t(1) << c, 0, 0, 0}, 1};
+                    place(single, r, labels++);
+                }
+            }
+        }
+    }
+
+    int label(int c, int r) const {
+        return p_label[(r * p_cw) + c];
+    }
+
+    // one fill wall per run of same-piece cells along a coarse row, then per run of joined cells
+    // along each corridor row between two coarse rows
+    void fill() {
+        int gw = p_w - 2;
+        p_grid.assign(gw * (p_h - 2), cell_path);
+        p_rects.clear();
+        auto wall = [&](int x, int y, int w, int h) {
+            p_rects.push_back({x, y, w, h});
+            for (int ty = y; ty < y + h; ty++) {
+                std::fill_n(p_grid.begin() + ((ty - 1) * gw) + (x - 1), w, (uint8_t) cell_wall);
+            }
+        };
+        if (p_strip_top) {
+            wall(1, 1, gw, 1);
+        }
+        if (p_strip_bottom) {
+            wall(1, p_h - 2, gw, 1);
+        }
+        for (int r = 0; r < p_ch; r++) {
+            int c = 0;
+            while (c < p_cw) {
+                int e = c;
+                while ((e + 1 < p_cw) && (label(e + 1, r) == label(c, r))) {
+                    e++;
+                }
+                wall(p_block_x[c], p_block_y[r], p_block_x[e] + p_block_w[e] - p_block_x[c], p_block_h[r]);
+                c = e + 1;
+            }
+            if (r + 1 == p_ch) {
+                break;
+            }
+            int y = p_block_y[r] + p_block_h[r];
+            c = 0;
+            while (c < p_cw) {
+                if (label(c, r) != label(c, r + 1)) {
+                    c++;
+                    continue;
+                }
+                // the corner between two joined columns closes only when all four cells are one piece
+                int e = c;
+                while ((e + 1 < p_cw) && (label(e + 1, r) == label(c, r)) && (label(e + 1, r + 1) == label(c, r))) {
+                    e++;
+                }
+                wall(p_block_x[c], y, p_block_x[e] + p_block_w[e] - p_block_x[c], 1);
+                c = e + 1;
+            }
+        }
+    }
+
+public:
+    PieceGenerator() {
+        addShape({"##"}, 3);
+        addShape({"###"}, 2);
+        addShape({"##", "#."}, 3);
+        addShape({"####"}, 1);
+        addShape({"##", "##"}, 1);
+        addShape({"###", "#.."}, 2);
+        addShape({"###", ".#."}, 3);
+        addShape({".##", "##."}, 1);
+        for (auto& p : p_pieces) {
+            p_weights.push_back((p_weights.empty() ? 0 : p_weights.back()) + p.weight);
+        }
+    }
+
+    const char* name() const override {
+        return "pieces";
+    }
+
+    // a row of coarse cells is one 64 bit mask, boards over about 256 tiles wide get wider blocks
+    void generate(uint32_t seed, int w, int h, int start_x, int start_y) override {
+        p_w = w;
+        p_h = h;
+        p_start_x = start_x;
+        p_start_y = start_y;
+        p_rng.seed(seed);
+        // the start line runs along whichever axis has room for it, rows first
+        int gw = w - 2;
+        int gh = h - 2;
+        split(gh, start_y, p_block_y, p_block_h);
+        split(gw, -1, p_block_x, p_block_w, 64);
+        p_strip_top = p_block_y.front() > 2;
+        p_strip_bottom = p_block_y.back() + p_block_h.back() < gh;
+        p_cw = (int) p_block_x.size();
+        p_ch = (int) p_block_y.size();
+        if (p_masks_cw != p_cw) {
+            buildMasks();
+        }
+        p_cut_row = blockBefore(p_block_y, p_block_h, start_y);
+        p_cut_col = blockAt(p_block_x, p_block_w, start_x);
+        if (p_cut_col < 0) {
+            // on a crossing, keeping the cells to its lower right apart is enough
+            p_cut_col = std::max(0, blockBefore(p_block_x, p_block_w, start_x) + 1);
+        }
+        tile();
+        fill();
+    }
+    const std::vector<uint8_t>& grid() const override {
+        return p_grid;
+    }
+    const std::vector<WallRect>& rects() const override {
+        return p_rects;
+    }
+};
+
+const char* const generator_names[] = {"walk", "pieces"};
+
+// nullptr for an unknown name, symmetric only applies to the walk
+inline std::unique_ptr<MazeGenerator> makeGenerator(const std::string& name, bool symmetric = false) {
+    if (name == "walk") {
+        auto walk = new WalkGenerator();
+        walk->setSymmetric(symmetric);
+        return std::unique_ptr<MazeGenerator>(walk);
+    } else if (name == "pieces") {
+        return std::unique_ptr<MazeGenerator>(new PieceGenerator());
+    }
+    return nullptr;
+}
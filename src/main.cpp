@@ -1,5 +1,68 @@
 #include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include "capture.hpp"
+#include "generator.hpp"
+#include "maze.hpp"
+#include "mazefile.hpp"
+#include "trace.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
 #include <random>
+#include <string>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// every heap allocation the program makes, counted for the --levels report. replacing the global
+// operators changes every run, so it is only built in with -DCOUNT_ALLOCATIONS (cmake -DCOUNT_ALLOCATIONS=ON)
+static std::atomic<uint64_t> heap_allocations{0};
+
+#ifdef COUNT_ALLOCATIONS
+const bool counting_allocations = true;
+
+// gcc inlines these into callers and then warns that the new and delete don't match
+#ifdef __GNUC__
+#define ALLOC_NOINLINE __attribute__((noinline))
+#else
+#define ALLOC_NOINLINE
+#endif
+
+ALLOC_NOINLINE void* operator new(std::size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc((size == 0) ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+ALLOC_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+ALLOC_NOINLINE void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+#else
+const bool counting_allocations = false;
+#endif
+
+// resident set size in kB, 0 where there is no /proc/self/statm to read it from
+long residentKB() {
+#ifdef __linux__
+    std::ifstream f("/proc/self/statm");
+    long size = 0;
+    long resident = 0;
+    if (f >> size >> resident) {
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+#endif
+    return 0;
+}
 
 float toGlobalPos_x(float x) {
     float tile_dim = 8.f;
@@ -66,13 +129,6 @@ public:
 
 };
 
-Vec2 randomDirection(std::vector<Vec2> possibleDirections) {
-    std::random_device rd;
-    std::uniform_int_distribution<int> dist(0,(possibleDirections.size() - 1)); 
-    int rand = dist(rd);
-    return possibleDirections[rand];
-}
-
 void resetDirections(std::vector<Vec2>& possible_directions) { 
     bool has_up = false;
     bool has_left = false;
@@ -121,6 +177,15 @@ public:
     sf::RectangleShape shape;
     bool has = false;
     CVisual() {} 
+    void reset() {
+        local_pos = {0, 0};
+        global_pos = {0, 0};
+        width = 0;
+        height = 0;
+        shape.setSize(sf::Vector2f(0.f, 0.f));
+        shape.setPosition(0.f, 0.f);
+        shape.setFillColor(sf::Color::White);
+    }
 };
 
 class CMovement {
@@ -131,6 +196,11 @@ public:
     CMovement() {
         resetDirections(possible_directions);
     }
+    void reset() {
+        vel_cache.assign(1, Vec2(0, 0));
+        possible_directions.clear();
+        resetDirections(possible_directions);
+    }
 };
 
 class CBBox {
@@ -138,6 +208,9 @@ public:
     sf::FloatRect rect;
     bool has = false;
     CBBox() {}
+    void reset() {
+        rect = sf::FloatRect();
+    }
 };
 
 class CPathTile {
@@ -164,6 +237,14 @@ public:
         : pos(Vec2(x, y)), w(width), h(height) {
         resetDirections(possible_directions);
     }
+    void reset(float x, float y, float width, float height) {
+        pos = Vec2(x, y);
+        wall = false;
+        w = width;
+        h = height;
+        possible_directions.clear();
+        resetDirections(possible_directions);
+    }
 };
 
 class CDot {
@@ -172,6 +253,10 @@ public:
     bool big;
     bool has = false;
     CDot() {}
+    void reset() {
+        tile_pos = Vec2();
+        big = false;
+    }
     // TODO: create and center dot in pathtile -> mark pathtile for deletion
 };
 
@@ -192,11 +277,22 @@ typedef std::tuple<CVisual, CMovement, CBBox, CTile, CPathTile, CDot> ComponentT
 
 class Entity {
     friend class EntityManager;
-    const entityType p_tag;
-    const size_t p_id = 0;
+    entityType p_tag;
+    size_t p_id = 0;
     ComponentTuple p_components = std::make_tuple(CVisual(), CMovement(), CBBox(), CTile(), CPathTile(), CDot());
     Entity(const entityType tag, size_t id)
         : p_id(id), p_tag(tag) {}
+    // hand a used arena slot out again, components stay allocated but count as absent until added
+    void reuse(const entityType tag, size_t id) {
+        p_tag = tag;
+        p_id = id;
+        p_isActive = true;
+        getComponent<CVisual>().has = false;
+        getComponent<CMovement>().has = false;
+        getComponent<CBBox>().has = false;
+        getComponent<CTile>().has = false;
+        getComponent<CDot>().has = false;
+    }
 public:
     bool p_isActive = true;
     template <typename T>
@@ -207,16 +303,18 @@ public:
     bool hasComponent() {
         return getComponent<T>().has;
     }
+    // reset in place rather than assigned a new component, so the storage it owns is reused
     template <typename T, typename... TArgs>
     T& addComponent(TArgs&&... mArgs) {
         auto& component = getComponent<T>();
-        component = T(std::forward<TArgs>(mArgs)...);
+        component.reset(std::forward<TArgs>(mArgs)...);
         component.has = true;
         return component;
     }
     template <typename T>
     void removeComponent() {
-        getComponent<T>() = T();
+        getComponent<T>().reset();
+        getComponent<T>().has = false;
     }
     // assume position is in terms of local grid position
     void addPosition(float x, float y) {
@@ -248,21 +346,25 @@ public:
     }
 };
 
-typedef std::vector<std::shared_ptr<Entity>> EntityVec;
+typedef std::vector<Entity*> EntityVec;
 
 typedef std::map<entityType, EntityVec> EntityMap;
 
+// entities live in a per-level arena: slots are handed out in order and only taken back all at once by reset,
+// and a slot keeps what its components allocated, so a level no bigger than an earlier one needs no heap memory
 class EntityManager {
+    std::vector<std::unique_ptr<Entity>> p_arena;
+    size_t p_used = 0;
     EntityVec p_entities;
     EntityMap p_entityMap;
     size_t p_entityTotal = 0;
     EntityVec p_toAdd;
 public:
     EntityManager() {};
-    static bool toDelete(const std::shared_ptr<Entity>& e) {
+    static bool toDelete(const Entity* e) {
         return !(e->p_isActive);
     }
-    static bool toDeleteMap(const std::pair<const entityType, std::vector<std::shared_ptr<Entity>, std::allocator<std::shared_ptr<Entity>>>> e) {
+    static bool toDeleteMap(const std::pair<const entityType, EntityVec>& e) {
         return !(e.second[0]->p_isActive);
     }
     template< typename ContainerT, typename PredicateT >
@@ -273,6 +375,7 @@ public:
         }
     }
     void update() {
+        TRACE_SCOPE("EntityManager::update");
         for (auto e : p_toAdd) {
             p_entities.push_back(e);
             p_entityMap[e->p_tag].push_back(e);
@@ -284,11 +387,28 @@ public:
             m.second.erase(std::remove_if(m.second.begin(), m.second.end(), toDelete), m.second.end());
         }
     }
-    std::shared_ptr<Entity> addEntity(const entityType& tag) {
-        auto e = std::shared_ptr<Entity>(new Entity(tag, p_entityTotal++));
+    Entity* addEntity(const entityType& tag) {
+        if (p_used == p_arena.size()) {
+            p_arena.emplace_back(new Entity(tag, p_entityTotal));
+        }
+        Entity* e = p_arena[p_used++].get();
+        e->reuse(tag, p_entityTotal++);
         p_toAdd.push_back(e);
         return e;
     }
+    // ends the level: every entity goes at once and the pointers addEntity handed out are dangling
+    void reset() {
+        p_used = 0;
+        p_entityTotal = 0;
+        p_entities.clear();
+        for (auto& m : p_entityMap) {
+            m.second.clear();
+        }
+        p_toAdd.clear();
+    }
+    size_t arenaSize() const {
+        return p_arena.size();
+    }
     EntityVec& getEntities() {
         return p_entities;
     }
@@ -297,15 +417,282 @@ public:
     }
 };
 
+// arrow keys held during a tick, one bit each
+enum inputBit {
+    in_right = 1 << 0,
+    in_left = 1 << 1,
+    in_up = 1 << 2,
+    in_down = 1 << 3
+};
+
+struct InputEvent {
+    uint64_t tick;
+    uint8_t input;
+};
+
+// generation options a recorded session was played with
+enum logFlag {
+    log_symmetric = 1 << 0,
+    log_pieces = 1 << 1
+};
+
+// recorded session: the maze seed and options, every change of the per-tick input and a state checksum every N ticks
+// events are stored as (varint tick delta, input byte) so a session of held keys stays a few bytes long
+// version 3 sessions have dots and levels, older ones play out differently and are refused
+const uint8_t log_version = 3;
+
+class InputLog {
+    uint64_t p_last_tick = 0;
+    uint8_t p_last_input = 0;
+
+    static void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((uint8_t) (v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t) v);
+    }
+    static bool getVarint(const std::vector<uint8_t>& in, size_t& pos, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; (pos < in.size()) && (shift < 64); shift += 7) {
+            uint8_t b = in[pos++];
+            v |= (uint64_t) (b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+public:
+    uint8_t version = log_version;
+    uint32_t seed = 0;
+    uint32_t flags = 0;
+    uint32_t checksum_every = 60;
+    uint64_t ticks = 0;
+    std::vector<uint8_t> events;
+    std::vector<uint64_t> checksums;
+
+    void record(uint64_t tick, uint8_t input) {
+        if (input == p_last_input) {
+            return;
+        }
+        putVarint(events, tick - p_last_tick);
+        events.push_back(input);
+        p_last_tick = tick;
+        p_last_input = input;
+    }
+
+    std::vector<InputEvent> decode() const {
+        std::vector<InputEvent> out;
+        uint64_t tick = 0;
+        size_t pos = 0;
+        uint64_t delta;
+        while ((pos < events.size()) && getVarint(events, pos, delta) && (pos < events.size())) {
+            tick += delta;
+            out.push_back({tick, events[pos++]});
+        }
+        return out;
+    }
+
+    bool save(const std::string& path) const {
+        std::vector<uint8_t> out = {'P', 'M', 'I', 'R', log_version};
+        putVarint(out, seed);
+        putVarint(out, flags);
+        putVarint(out, checksum_every);
+        putVarint(out, ticks);
+        putVarint(out, events.size());
+        out.insert(out.end(), events.begin(), events.end());
+        putVarint(out, checksums.size());
+        for (auto c : checksums) {
+            for (int i = 0; i < 8; i++) {
+                out.push_back((uint8_t) (c >> (8 * i)));
+            }
+        }
+        std::ofstream f(path, std::ios::binary);
+        f.write((const char*) out.data(), out.size());
+        return (bool) f;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream f(path, std::ios::binary);
+        std::vector<uint8_t> in((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        if ((in.size() < 5) || (in[0] != 'P') || (in[1] != 'M') || (in[2] != 'I') || (in[3] != 'R')) {
+            version = 0;
+            return false;
+        }
+        // the version is kept for the caller to explain a refusal
+        version = in[4];
+        if (version != log_version) {
+            return false;
+        }
+        size_t pos = 5;
+        uint64_t v_seed, v_flags, v_every, v_size, v_count;
+        if (!getVarint(in, pos, v_seed) || !getVarint(in, pos, v_flags) || !getVarint(in, pos, v_every) || !getVarint(in, pos, ticks) || !getVarint(in, pos, v_size)) {
+            return false;
+        }
+        if ((v_every == 0) || (v_size > in.size() - pos)) {
+            return false;
+        }
+        seed = (uint32_t) v_seed;
+        flags = (uint32_t) v_flags;
+        checksum_every = (uint32_t) v_every;
+        events.assign(in.begin() + pos, in.begin() + pos + v_size);
+        pos += v_size;
+        if (!getVarint(in, pos, v_count) || (v_count > (in.size() - pos) / 8)) {
+            return false;
+        }
+        checksums.clear();
+        for (uint64_t n = 0; n < v_count; n++) {
+            uint64_t c = 0;
+            for (int i = 0; i < 8; i++) {
+                c |= (uint64_t) in[pos++] << (8 * i);
+            }
+            checksums.push_back(c);
+        }
+        return true;
+    }
+};
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+struct KeyTransition {
+    TimePoint time;
+    uint8_t bit;
+    bool down;
+};
+
+// keyboard input for the simulation, the held keys are read once per tick while key presses and releases
+// from window events are queued with the time they were seen, which starts the latency clock for the
+// frame that first shows the tick that consumed them
+class InputSampler {
+    std::vector<KeyTransition> p_queue;
+    uint8_t p_state = 0;
+    bool p_pending = false;
+    TimePoint p_pending_since;
+    FrameTimes p_latency = FrameTimes(256);
+
+    static uint8_t bitOf(sf::Keyboard::Key key) {
+        switch (key) {
+            case sf::Keyboard::Right: return in_right;
+            case sf::Keyboard::Left: return in_left;
+            case sf::Keyboard::Up: return in_up;
+            case sf::Keyboard::Down: return in_down;
+            default: return 0;
+        }
+    }
+public:
+    static uint8_t poll() {
+        uint8_t input = 0;
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) {
+            input |= in_right;
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
+            input |= in_left;
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) {
+            input |= in_up;
+        }
+        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) {
+            input |= in_down;
+        }
+        return input;
+    }
+
+    void onEvent(const sf::Event& event, TimePoint now) {
+        if ((event.type == sf::Event::KeyPressed) || (event.type == sf::Event::KeyReleased)) {
+            uint8_t bit = bitOf(event.key.code);
+            if (bit != 0) {
+                p_queue.push_back({now, bit, event.type == sf::Event::KeyPressed});
+            }
+        }
+    }
+
+    // the input for one tick, keys that changed without an event (focus changes) are stamped now
+    // called on every tick, while the game ignores input (live false) it only keeps the queue and
+    // key state current so the first sample after spawn doesn't time a stale transition
+    uint8_t sample(TimePoint now, bool live) {
+        TRACE_SCOPE("sample input");
+        uint8_t input = poll();
+        uint8_t changed = input ^ p_state;
+        if (live && (changed != 0) && !p_pending) {
+            p_pending = true;
+            p_pending_since = now;
+            for (auto& t : p_queue) {
+                if ((t.bit & changed) && (t.time < p_pending_since)) {
+                    p_pending_since = t.time;
+                }
+            }
+        }
+        p_queue.clear();
+        p_state = input;
+        return input;
+    }
+
+    // call after a frame is presented, closes the latency of the input change the frame first shows
+    void presented(TimePoint now) {
+        if (p_pending) {
+            p_latency.add(std::chrono::duration<float, std::milli>(now - p_pending_since).count());
+            p_pending = false;
+        }
+    }
+
+    const FrameTimes& latency() const {
+        return p_latency;
+    }
+};
+
+// how frames are paced: the SFML frame limiter, vertical sync, sleeping then spinning up to each
+// frame's deadline, or no pacing at all, the simulation ticks at a fixed rate in every mode
+enum paceMode {
+    pace_limit,
+    pace_vsync,
+    pace_spin,
+    pace_uncapped
+};
+
 class GameEngine {
-    sf::RenderWindow p_window = sf::RenderWindow{ { 224, 290 }, "Pacman" };
-    int p_fps = 144;
+    sf::RenderWindow p_window;
+    int p_fps = 144;            // simulation ticks per second
+    int p_frame_limit = 144;    // frames per second for pace_limit and pace_spin
+    paceMode p_pace = pace_limit;
+    InputSampler p_input;
     float p_tiledim = 8;
     float p_w = 28;
     float p_h = 30;
     int total_score = 0;
+    uint32_t p_seed;
+    uint64_t p_tick = 0;
+    bool p_recording = false;
+    std::string p_trace_path = "trace.json";
+    bool p_overlay = false;
+    FrameTimes p_frame_times;
+    TimePoint p_title_at;
+    sf::VertexArray p_overlay_bars = sf::VertexArray(sf::Quads);
+    FrameCapture p_capture;
+
+    // generation is advanced one step per tick by sGenerate, eating the last dot starts the next level
+    MazeBuilder p_builder;
+    // any other strategy runs to the end up front and p_reveal plays its maze back one event per tick
+    std::unique_ptr<MazeGenerator> p_generator;
+    // a maze loaded with --maze, played on every level instead of generating one
+    MazeFile p_maze_file;
+    bool p_fixed_maze = false;
+    std::vector<MazeEvent> p_reveal;
+    size_t p_revealed = 0;
+    std::vector<uint8_t> p_reveal_seen;
+    std::vector<int> p_reveal_queue;
+    uint32_t p_level = 0;
+    int p_dots_eaten = 0;
+    bool p_allow_input = false;
+    bool p_initialize_player = false;
+    float p_player_x = 3.f;
+    float p_player_y = 14.f;
 public:
-    std::array<std::shared_ptr<Entity>, (26 * 28)> p_entity_grid;
+    InputLog p_log;
+    std::array<Entity*, (26 * 28)> p_entity_grid{};
+    std::array<Entity*, (26 * 28)> p_dot_grid{};
+    // fill wall entities in the order of p_builder.rects(), only lined up on asymmetric boards
+    std::vector<Entity*> p_wall_entities;
     void cacheVel(CMovement& p_cMov, float x, float y) {
         if (!((p_cMov.vel_cache[0].x == x) && (p_cMov.vel_cache[0].y == y))) {
             if (p_cMov.vel_cache.size() == 1) {
@@ -317,29 +704,36 @@ public:
         }
     }
     EntityManager EManager = EntityManager();
-    GameEngine() {}
-    
+    GameEngine(uint32_t seed, bool headless = false)
+        : p_seed(seed), p_builder(seed, 28, 30, 3, 14) {
+        if (!headless) {
+            p_window.create(sf::VideoMode(224, 290), "Pacman");
+        }
+    }
+
     // TODO: dynamic pixel movement
-    void sUserInput() {
+    void sUserInput(uint8_t input) {
+        TRACE_SCOPE("sUserInput");
         for (auto p : EManager.getEntities(player)) {
             auto& p_cMov = p->getComponent<CMovement>();
             
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right)) {
+            if (input & in_right) {
                 cacheVel(p_cMov, 1.f / 16.f, 0.f);
             }
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left)) {
+            if (input & in_left) {
                 cacheVel(p_cMov, -1.f  / 16.f, 0.f);
             }
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up)) {
+            if (input & in_up) {
                 cacheVel(p_cMov, 0.f, -1.f  / 16.f);
             }
-            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down)) {
+            if (input & in_down) {
                 cacheVel(p_cMov, 0.f, 1.f / 16.f);
             } 
        }
     }
 
     bool isCollision(Vec2& vel) {
+        TRACE_SCOPE("isCollision");
         bool collision = false;
         for (auto& p : EManager.getEntities(player)) {
             auto& p_cBBox = p->getComponent<CBBox>();
@@ -353,8 +747,9 @@ public:
             }
             for (auto& d : EManager.getEntities(dot)) {
                 auto& d_cBBox = d->getComponent<CBBox>();
-                if (p_cBBox.rect.intersects(d_cBBox.rect)) {
+                if (d->p_isActive && p_cBBox.rect.intersects(d_cBBox.rect)) {
                     d->p_isActive = false;
+                    p_dots_eaten++;
                 }
             }
 
@@ -386,8 +781,8 @@ public:
         return Vec2((float) x, (float) y);
     }
 
-    void setInGrid(std::shared_ptr<Entity> t) {
-        auto t_cTile = t->getComponent<CTile>();
+    void setInGrid(Entity* t) {
+        auto& t_cTile = t->getComponent<CTile>();
         auto t_pos = t_cTile.pos;
         auto w = t_cTile.w;
         auto h = t_cTile.h;
@@ -404,14 +799,14 @@ public:
         }  
     }
 
-    void removeFromGrid(std::shared_ptr<Entity> t) {
+    void removeFromGrid(Entity* t) {
         auto t_pos = t->getComponent<CTile>().pos;
         auto index = toGridIndex(t_pos);
         t->p_isActive = false;
         p_entity_grid[index] = 0;
     } 
 
-    std::shared_ptr<Entity> getFromGrid(Vec2 pos) {
+    Entity* getFromGrid(Vec2 pos) {
         auto index = toGridIndex(pos);
         return p_entity_grid[index];
     }
@@ -419,92 +814,8 @@ public:
         auto index = toGridIndex(pos);
         return (p_entity_grid[index] != 0);
     }
-    void horizontalIncrement(int& grid_counter) {
-        int grid_w = p_w - 2.f;
-        int grid_h = p_h - 2.f;
-
-        int col_num = grid_counter % grid_w;
-        int col_bottom = col_num + ((grid_h - 1) * grid_w);
-
-        if (grid_counter == col_bottom) {
-            if (col_num != grid_w - 1.f) {    
-                grid_counter = col_num + 1;
-            } else {
-                grid_counter++;
-            }
-        } else {
-            grid_counter += grid_w;
-        }
-    }
-    void horizontalFill(int& grid_counter) {
-        // go through entire grid array filling empty spaces with rectangles when greater than 2 tiles in a row
-        // first go through horizontally, save single tile vertical spaces with an array
-        // next go through created array with vertical movements
-        // finally get rid of any tiles that are 1x1 tile size
-        int b_w = 1.f;
-        int w = (p_w - (2.f * b_w));
-        int h = (p_h - (2.f * b_w));
-        int grid_size = ((p_w - (2.f * b_w)) * (p_h - (2.f * b_w)));
-        int seq_counter = 0;
-        for (; grid_counter < grid_size; grid_counter += 1) {
-            auto t_curr = p_entity_grid[grid_counter];
-            if (t_curr == 0) {
-                seq_counter++;
-            }
-            auto pos = fromGridIndex(grid_counter); 
-            // row end
-            if ((t_curr != 0) || ((grid_counter % w) == (w - 1.f))) {
-                auto new_x = pos.x + 1.f - (seq_counter - 1);
-                if (seq_counter > 1) {
-                    if (t_curr != 0) {    
-                        new_x -= 1; 
-                    } 
-                    auto f = makeWall(seq_counter, 1.f, new_x, pos.y + 1.f, true, sf::Color(210, 4, 45));
-                    setInGrid(f);
-                    break;
-                } else {
-                    seq_counter = 0;
-                }
-            } 
-        }
-        EManager.update(); 
-    }
-    void verticalFill(int& grid_counter) {
-        int b_w = 1.f;
-        int w = (p_w - (2.f * b_w));
-        int h = (p_h - (2.f * b_w));
-        int grid_size = ((p_w - (2.f * b_w)) * (p_h - (2.f * b_w)));
-        int seq_counter = 0;
-        bool empty_space = false;
-        for (; grid_counter < grid_size; ) {
-            auto t_curr = p_entity_grid[grid_counter]; 
-            if (t_curr == 0) {
-                seq_counter++;
-                empty_space = true;
-            } else if (t_curr->getComponent<CTile>().wall) {
-                seq_counter++;
-            }
-            auto pos = fromGridIndex(grid_counter);
-            int y = pos.y;
-            if (y == (h - 1.f)) {
-                y += 1.f;
-            }
-            if ((y == h) || ((t_curr != 0) && !(t_curr->getComponent<CTile>().wall))) {
-                if ((seq_counter > 1) && (empty_space)) {
-                    // blue: 0, 150, 255
-                    makeWall(1.f, seq_counter, pos.x + 1.f, y - seq_counter + 1.f, true, sf::Color(210, 4, 45));
-                    empty_space = false;
-                    horizontalIncrement(grid_counter);
-                    break;
-                }
-                seq_counter = 0;
-                empty_space = false;
-            }
-            horizontalIncrement(grid_counter);
-        }
-        EManager.update();
-    }
     void sUpdateMovement() {
+        TRACE_SCOPE("sUpdateMovement");
         for (auto& p : EManager.getEntities(player)) {
             auto& p_cMov = p->getComponent<CMovement>();
             if (p_cMov.vel_cache.size() == 2) {
@@ -521,156 +832,525 @@ public:
             }
         }
     }
-    void sRender() {
-        p_window.setFramerateLimit(p_fps);
-        float t_w = 1.f;
-        float t_h = 1.f;
-        float b_w = 1.f;
-        EntityVec walls;
-
-        float player_x = 3.f;
-        float player_y = 14.f;
-        
-        auto start_tile = makeWall(t_w, t_h, player_x, player_y, false);
+    void init() {
+        makeBorders(p_w, p_h, 0.f, 0.f);
+        auto start_tile = makeWall(1.f, 1.f, p_player_x, p_player_y, false);
         setInGrid(start_tile);
-        walls.push_back(start_tile); // TODO make random
-        int wall_count = 0;
+        if (p_builder.symmetric()) {
+            setInGrid(makeWall(1.f, 1.f, p_w - 1.f - p_player_x, p_player_y, false));
+        }
+        if (p_fixed_maze) {
+            p_builder.loadMaze(p_maze_file.grid, p_maze_file.walls);
+            revealBuilder();
+        } else if (p_generator) {
+            runGenerator();
+        }
         EManager.update(); 
-        
-        bool build_wall = true;
-        bool pruned = false;
-        int grid_counter = 0; 
-        int grid_size = ((p_w - (2.f * b_w)) * (p_h - (2.f * b_w)));
-        bool h_fill = true;
-        bool v_fill = true;
-        bool allow_input = false;
-        bool initialize_player = false;
+    }
 
-        while (p_window.isOpen()) {
-            for (auto event = sf::Event{}; p_window.pollEvent(event);) {
-                if (event.type == sf::Event::Closed) {
-                    p_window.close();
-                }
-                if (allow_input) {
-                    sUserInput();
-                }
+    // the builder takes the finished maze so dots and regenerate see it like a walked one
+    void runGenerator() {
+        TRACE_SCOPE("runGenerator");
+        p_generator->generate(levelSeed(), p_builder.width(), p_builder.height(), p_builder.startX(), p_builder.startY());
+        p_builder.loadMaze(p_generator->grid(), p_generator->rects());
+        revealBuilder();
+    }
+
+    // queues the builder's finished maze for sGenerate, the corridors breadth first from the start so
+    // they grow out of it, then the walls in rects() order
+    void revealBuilder() {
+        p_reveal.clear();
+        p_revealed = 0;
+        auto& seen = p_reveal_seen;
+        auto& queue = p_reveal_queue;
+        seen.assign(p_builder.grid().size(), 0);
+        queue.assign(1, p_builder.toGridIndex(p_builder.startX(), p_builder.startY()));
+        seen[queue[0]] = 1;
+        for (size_t head = 0; head < queue.size(); head++) {
+            int x, y;
+            p_builder.fromGridIndex(queue[head], x, y);
+            if (head > 0) {
+                MazeEvent ev;
+                ev.type = ev_path;
+                ev.x = x;
+                ev.y = y;
+                p_reveal.push_back(ev);
             }
-            sUpdateMovement();
-            p_window.clear();
-            // if a tile is the curr_tile after pruning, then save the current possible directions
-            if (build_wall) {
-                auto& t = walls[wall_count];
-                auto curr_pos = t->getComponent<CTile>().pos;
-                auto new_t = wallBuilder(t);
-                auto new_pos = new_t->getComponent<CTile>().pos;
-                if (new_pos == curr_pos) {
-                    // try to prune an extra branch
-                    if (toPrune(curr_pos)) {
-                        // consider 2 branches in a row?
-                        // consider 0 case?
-                        if (wall_count != 0) {
-                            wall_count--;  
-                            auto& prev_t = walls[wall_count];
-                            auto prev_pos = prev_t->getComponent<CTile>().pos;
-                            removeFromGrid(t);
-                            pruned = true;
-                        } else {
-                            build_wall = false;             // TODO: pruning start point moves player character for a consistent pathway system
-                            pruned = false;
-                        }
-                    // backtrack after pruning branches
-                    } else {
-                        Vec2 prev_pos;
-                        Vec2 n_pos;
-                        do {
-                            if (wall_count > 0) {
-                                wall_count--;
-                                if (wall_count == 0) {
-                                    wall_count = wall_count + 1 - 1;
-                                }
-                                auto prev_t = walls[wall_count];
-                                new_t = wallBuilder(prev_t);
-                                auto temp_pos = prev_t->getComponent<CTile>().pos;
-                                prev_pos.x = temp_pos.x;
-                                prev_pos.y = temp_pos.y;
-                                n_pos = new_t->getComponent<CTile>().pos;
-                            } else {
-                                build_wall = false;
-                                break;
-                            }
-                        } while (n_pos == prev_pos);
-
-                        if (pruned) {
-                            pruned = false;
-                        }
+            for (int d = 0; d < 4; d++) {
+                if (p_builder.at(x + dir_x[d], y + dir_y[d]) == cell_path) {
+                    int n = p_builder.toGridIndex(x + dir_x[d], y + dir_y[d]);
+                    if (!seen[n]) {
+                        seen[n] = 1;
+                        queue.push_back(n);
                     }
-                } else if (pruned) {
-                    pruned = false;
                 }
+            }
+        }
+        for (size_t i = 0; i < p_builder.rects().size(); i++) {
+            MazeEvent ev;
+            ev.type = ev_wall;
+            ev.rect = p_builder.rects()[i];
+            ev.index = (int) i;
+            p_reveal.push_back(ev);
+        }
+    }
+
+    void applyGenerated(const MazeEvent& ev) {
+        if (ev.type == ev_path) {
+            auto t = makeWall(1.f, 1.f, ev.x, ev.y, false);
+            // corridors opened after the player spawned must not block it either, and get their dots
+            if (p_allow_input) {
+                t->getComponent<CBBox>().has = false;
+                makeDot(ev.x, ev.y);
+            }
+            setInGrid(t);
+        } else if (ev.type == ev_prune) {
+            removeFromGrid(getFromGrid(Vec2(ev.x, ev.y)));
+            auto& d = p_dot_grid[toGridIndex(Vec2(ev.x, ev.y))];
+            if ((d != 0) && d->p_isActive) {
+                d->p_isActive = false;
+                p_dots_eaten++;
+            }
+            d = 0;
+        } else if (ev.type == ev_wall) {
+            auto t = makeWall(ev.rect.w, ev.rect.h, ev.rect.x, ev.rect.y, true, sf::Color(210, 4, 45));
+            setInGrid(t);
+            p_wall_entities.push_back(t);
+        } else if (ev.type == ev_unwall) {
+            // the cells it covered are overwritten by the path and wall events that follow
+            p_wall_entities[ev.index]->p_isActive = false;
+            p_wall_entities[ev.index] = p_wall_entities.back();
+            p_wall_entities.pop_back();
+        }
+    }
+
+    // eaten dots leave the level, the last one ends it
+    void sLevel() {
+        if (p_dots_eaten == 0) {
+            return;
+        }
+        p_dots_eaten = 0;
+        EManager.update();
+        if (EManager.getEntities(dot).empty()) {
+            nextLevel();
+        }
+    }
+
+    // per level seeds follow from the session seed, so a recording only needs the first
+    uint32_t levelSeed() const {
+        return p_seed + p_level * 0x9e3779b9u;
+    }
+
+    // the whole level goes with one arena reset, then the next one starts generating
+    void nextLevel() {
+        p_level++;
+        EManager.reset();
+        p_entity_grid.fill(nullptr);
+        p_dot_grid.fill(nullptr);
+        p_wall_entities.clear();
+        p_builder.reset(levelSeed());
+        p_allow_input = false;
+        p_initialize_player = false;
+        init();
+    }
 
-                if ((build_wall) && (!pruned)) {
-                    wall_count++;
-                    auto it = walls.begin();
-                    it += wall_count;
-                    setInGrid(new_t);
-                    walls.insert(it, new_t);
-                    EManager.update();
-                } else if (pruned) {
-                    EManager.update();
+    uint32_t level() const {
+        return p_level;
+    }
+    bool playing() const {
+        return p_allow_input;
+    }
+    size_t arenaSize() const {
+        return EManager.arenaSize();
+    }
+
+    // eats every dot at once, for headless runs through many levels
+    void eatDots() {
+        for (auto& d : EManager.getEntities(dot)) {
+            if (d->p_isActive) {
+                d->p_isActive = false;
+                p_dots_eaten++;
+            }
+        }
+    }
+
+    // re-roll a rectangle of the finished board in place, refused while the player stands in it
+    bool regenerate(WallRect region, uint32_t seed) {
+        if (!p_allow_input || p_builder.symmetric()) {
+            return false;
+        }
+        for (auto& p : EManager.getEntities(player)) {
+            auto pos = p->getComponent<CVisual>().local_pos;
+            if ((pos.x + 1.f > region.x) && (pos.x < region.x + region.w) &&
+                (pos.y + 1.f > region.y) && (pos.y < region.y + region.h)) {
+                return false;
+            }
+        }
+        TRACE_SCOPE("regenerate");
+        bool joined = p_builder.regenerate(region, seed);
+        for (auto& ev : p_builder.changes()) {
+            applyGenerated(ev);
+        }
+        // fill walls can overlap, a cell may still point at a removed wall while another one covers it
+        WallRect dirty = p_builder.dirtyArea();
+        for (int y = dirty.y; y < dirty.y + dirty.h; y++) {
+            for (int x = dirty.x; x < dirty.x + dirty.w; x++) {
+                auto& t = p_entity_grid[toGridIndex(Vec2(x, y))];
+                if ((t != 0) && !t->p_isActive && (p_builder.rectAt(x, y) != -1)) {
+                    t = p_wall_entities[p_builder.rectAt(x, y)];
                 }
-            } else if (h_fill) {
-                horizontalFill(grid_counter);
-                if (grid_counter == grid_size) {
-                    h_fill = false;
-                    grid_counter = 0;
+            }
+        }
+        EManager.update();
+        return joined;
+    }
+
+    // generate only the left half and mirror it, call before init
+    void setSymmetric(bool symmetric) {
+        p_builder.setSymmetric(symmetric);
+        p_builder.reset(p_seed);
+    }
+
+    // one of generator_names, call before init, only the walk can be symmetric
+    bool setGenerator(const std::string& name) {
+        if (name == "walk") {
+            p_generator.reset();
+            return true;
+        }
+        p_generator = makeGenerator(name);
+        setSymmetric(false);
+        return p_generator != nullptr;
+    }
+
+    // plays f on every level, call before init, false when it doesn't fit this board
+    bool setMaze(const MazeFile& f) {
+        if ((f.w != (int) p_w) || (f.h != (int) p_h) || (f.start_x != (int) p_player_x) || (f.start_y != (int) p_player_y)) {
+            return false;
+        }
+        p_maze_file = f;
+        p_fixed_maze = true;
+        p_generator.reset();
+        setSymmetric(false);
+        return true;
+    }
+
+    // advance the generator one step and mirror what it changed into entities
+    void sGenerate() {
+        if (p_revealed < p_reveal.size()) {
+            TRACE_SCOPE("reveal");
+            applyGenerated(p_reveal[p_revealed++]);
+            if (p_revealed == p_reveal.size()) {
+                p_initialize_player = true;
+            }
+            EManager.update();
+        } else if (!p_builder.done()) {
+            TraceScope scope(p_builder.phase());
+            MazeEvent ev;
+            if (!p_builder.step(ev)) {
+                p_initialize_player = true;
+            }
+            applyGenerated(ev);
+            // the symmetric builder only works on the left half, copy each change to the right
+            if (p_builder.symmetric()) {
+                ev.x = (int) p_w - 1 - ev.x;
+                ev.rect.x = (int) p_w - ev.rect.x - ev.rect.w;
+                applyGenerated(ev);
+            }
+            EManager.update();
+        // initialize player
+        } else if (p_initialize_player) {
+            
+            auto p = EManager.addEntity(player);
+            p->addComponent<CVisual>();
+            p->addComponent<CMovement>();
+            p->addComponent<CBBox>();
+            auto& p_cVis = p->getComponent<CVisual>();
+            p_cVis.width = 1.f;
+            p_cVis.height = 1.f;
+            p_cVis.shape.setSize(sf::Vector2f(8.f, 8.f));
+            p_cVis.shape.setFillColor(sf::Color(255, 219, 88));
+            p->setPosition(p_player_x, p_player_y);
+            makeDots();
+            EManager.update();
+            // TODO: remove non-wall tiles
+            for (auto t : EManager.getEntities(tile)) {
+                auto& t_cTile = t->getComponent<CTile>();
+                if (!t_cTile.wall) {
+                    t->getComponent<CBBox>().has = false;
                 }
-            } else if (v_fill) {
-                verticalFill(grid_counter);
-                if (grid_counter == grid_size) {
-                    v_fill = false;
-                    grid_counter = 0;
-                    initialize_player = true;
+            }
+            p_allow_input = true;
+            p_initialize_player = false;
+            EManager.update();
+        }
+    }
+
+    // one simulation tick: apply the tick's input, move, then advance generation
+    void step(uint8_t input) {
+        TRACE_SCOPE("step");
+        if (p_recording) {
+            p_log.record(p_tick, input);
+        }
+        sUserInput(input);
+        sUpdateMovement();
+        sLevel();
+        sGenerate();
+        p_tick++;
+        if (p_recording && ((p_tick % p_log.checksum_every) == 0)) {
+            p_log.checksums.push_back(stateChecksum());
+        }
+    }
+
+    void setPacing(paceMode pace, int frame_limit) {
+        p_pace = pace;
+        p_frame_limit = std::max(1, frame_limit);
+    }
+
+    // every presented frame goes to path until the window closes, call after setPacing
+    // streams run at the frame limit when one is set, otherwise at the tick rate, the picture only moves on ticks
+    bool startCapture(const std::string& path, int buffers) {
+        int fps = ((p_pace == pace_limit) || (p_pace == pace_spin)) ? p_frame_limit : p_fps;
+        auto size = p_window.getSize();
+        return p_capture.start(path, size.x, size.y, fps, std::max(1, buffers));
+    }
+
+    // copies the finished back buffer into a free capture buffer before display swaps it away,
+    // glReadPixels waits for the frame to finish drawing, which is most of the cost it reports
+    void sCapture() {
+        TRACE_SCOPE("capture");
+        auto start = std::chrono::steady_clock::now();
+        if (auto b = p_capture.acquire()) {
+            glReadPixels(0, 0, p_capture.width(), p_capture.height(), GL_RGBA, GL_UNSIGNED_BYTE, b->pixels.data());
+            p_capture.submit(b);
+        }
+        p_capture.addOverhead(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // sleeps to just short of the deadline, the OS wakes late by up to a scheduler quantum, and spins the rest
+    void sleepSpin(TimePoint deadline) {
+        TRACE_SCOPE("pace");
+        const auto margin = std::chrono::milliseconds(2);
+        auto now = std::chrono::steady_clock::now();
+        if (deadline - now > margin) {
+            std::this_thread::sleep_for(deadline - now - margin);
+        }
+        while (std::chrono::steady_clock::now() < deadline) {}
+    }
+
+    void sRender() {
+        p_window.setVerticalSyncEnabled(p_pace == pace_vsync);
+        p_window.setFramerateLimit((p_pace == pace_limit) ? p_frame_limit : 0);
+        const auto tick_len = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / p_fps));
+        const auto frame_len = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / p_frame_limit));
+        // a stall longer than this many ticks is dropped instead of caught up
+        const int max_catch_up = 8;
+        auto last_frame = std::chrono::steady_clock::now();
+        auto next_tick = last_frame;
+        auto next_frame = last_frame;
+
+        while (p_window.isOpen()) {
+            TRACE_SCOPE("frame");
+            {
+                TRACE_SCOPE("pollEvent");
+                for (auto event = sf::Event{}; p_window.pollEvent(event);) {
+                    if (event.type == sf::Event::Closed) {
+                        p_window.close();
+                    } else if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F1)) {
+                        p_overlay = !p_overlay;
+                        if (!p_overlay) {
+                            p_window.setTitle("Pacman");
+                        }
+                    } else if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F2)) {
+                        toggleTrace();
+                    } else if ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::F3) && !p_recording) {
+                        // re-roll the lower left quarter, left out of recordings since replays don't know about it
+                        regenerate({1, (int) p_h / 2, (int) p_w / 2 - 1, (int) p_h / 2 - 1}, (uint32_t) p_tick);
+                    }
+                    p_input.onEvent(event, std::chrono::steady_clock::now());
                 }
-            // initialize player
-            } else if (initialize_player) {
-                
-                auto p = EManager.addEntity(player);
-                p->addComponent<CVisual>();
-                p->addComponent<CMovement>();
-                p->addComponent<CBBox>();
-                auto& p_cVis = p->getComponent<CVisual>();
-                auto& p_cMov = p->getComponent<CMovement>();
-                auto& p_cBBox = p->getComponent<CBBox>();
-                p_cVis.width = 1.f;
-                p_cVis.height = 1.f;
-                p_cVis.shape.setSize(sf::Vector2f(8.f, 8.f));
-                p_cVis.shape.setFillColor(sf::Color(255, 219, 88));
-                p->setPosition(player_x, player_y);
-                EManager.update();
-                // TODO: remove non-wall tiles
-                for (auto t : EManager.getEntities(tile)) {
-                    auto& t_cTile = t->getComponent<CTile>();
-                    if (!t_cTile.wall) {
-                        t->getComponent<CBBox>().has = false;
+            }
+            // run the ticks that are due, the input is sampled once per tick so it can be recorded
+            auto now = std::chrono::steady_clock::now();
+            int ticks = 0;
+            while ((now >= next_tick) && (ticks < max_catch_up)) {
+                uint8_t input = p_input.sample(now, p_allow_input);
+                step(p_allow_input ? input : 0);
+                next_tick += tick_len;
+                ticks++;
+            }
+            if (ticks == max_catch_up) {
+                next_tick = now + tick_len;
+            }
+            {
+                TRACE_SCOPE("draw");
+                p_window.clear();
+                for (auto e : EManager.getEntities()) {
+                    if (e->hasComponent<CVisual>()) {
+                        auto& e_cVis = e->getComponent<CVisual>();
+                        p_window.draw(e_cVis.shape);
                     }
                 }
-                allow_input = true;
-                initialize_player = false;
-                EManager.update();
+                if (p_overlay) {
+                    sOverlay();
+                }
             }
-            
-            for (auto e : EManager.getEntities()) {
-                if (e->hasComponent<CVisual>()) {
-                    auto e_cVis = e->getComponent<CVisual>();
-                    p_window.draw(e_cVis.shape);
+            if (p_capture.running()) {
+                sCapture();
+            }
+            {
+                TRACE_SCOPE("display");
+                p_window.display();
+            }
+            now = std::chrono::steady_clock::now();
+            p_input.presented(now);
+            p_frame_times.add(std::chrono::duration<float, std::milli>(now - last_frame).count());
+            last_frame = now;
+            if (p_pace == pace_spin) {
+                next_frame = std::max(next_frame + frame_len, now - frame_len);
+                sleepSpin(next_frame);
+            }
+        }
+        p_log.ticks = p_tick;
+        if (p_capture.running()) {
+            p_capture.stop();
+            p_capture.report(std::cout);
+        }
+        if (Tracer::get().enabled()) {
+            toggleTrace();
+        }
+        auto& lat = p_input.latency();
+        std::cout << "frame ms: p50 " << p_frame_times.percentile(0.50) << ", p99 " << p_frame_times.percentile(0.99)
+                  << ", max " << p_frame_times.percentile(1.0) << "\n";
+        if (lat.size() > 0) {
+            std::cout << "input to present ms over the last " << lat.size() << " key changes: p50 " << lat.percentile(0.50)
+                      << ", p90 " << lat.percentile(0.90) << ", p99 " << lat.percentile(0.99) << ", max " << lat.percentile(1.0) << "\n";
+        }
+    }
+
+    // frame time graph in the strip above the board, one column per frame with the newest on the right
+    // and lines at the rolling p50 (white) and p99 (red), the full strip height is two frame budgets
+    void sOverlay() {
+        const float strip_h = 3.f * p_tiledim;
+        float budget = 1000.f / ((p_pace == pace_limit) || (p_pace == pace_spin) ? p_frame_limit : p_fps);
+        float scale = strip_h / (2.f * budget);
+        size_t n = std::min(p_frame_times.size(), (size_t) (p_w * p_tiledim));
+        p_overlay_bars.clear();
+        auto quad = [&](float x, float y, float w, float h, sf::Color c) {
+            p_overlay_bars.append(sf::Vertex(sf::Vector2f(x, y), c));
+            p_overlay_bars.append(sf::Vertex(sf::Vector2f(x + w, y), c));
+            p_overlay_bars.append(sf::Vertex(sf::Vector2f(x + w, y + h), c));
+            p_overlay_bars.append(sf::Vertex(sf::Vector2f(x, y + h), c));
+        };
+        for (size_t i = 0; i < n; i++) {
+            float ms = p_frame_times.recent(i);
+            float h = std::min(strip_h, ms * scale);
+            sf::Color c = (ms <= budget * 1.1f) ? sf::Color(80, 160, 80) : ((ms <= 2.f * budget) ? sf::Color(220, 180, 40) : sf::Color(220, 40, 40));
+            quad((p_w * p_tiledim) - 1.f - i, strip_h - h, 1.f, h, c);
+        }
+        float p50 = p_frame_times.percentile(0.50);
+        float p99 = p_frame_times.percentile(0.99);
+        quad(0.f, strip_h - std::min(strip_h, p50 * scale), p_w * p_tiledim, 1.f, sf::Color(255, 255, 255));
+        quad(0.f, strip_h - std::min(strip_h, p99 * scale), p_w * p_tiledim, 1.f, sf::Color(255, 60, 60));
+        p_window.draw(p_overlay_bars);
+
+        // there is no font to draw text with, the numbers go in the title bar a few times a second
+        auto now = std::chrono::steady_clock::now();
+        if (now >= p_title_at) {
+            p_title_at = now + std::chrono::milliseconds(250);
+            char title[128];
+            snprintf(title, sizeof(title), "Pacman  p50 %.1fms  p90 %.1fms  p99 %.1fms  max %.1fms  input p50 %.1fms",
+                     p50, p_frame_times.percentile(0.90), p99, p_frame_times.percentile(1.0), p_input.latency().percentile(0.50));
+            p_window.setTitle(title);
+        }
+    }
+
+    void setTracePath(const std::string& path) {
+        p_trace_path = path;
+    }
+
+    // starts recording a trace, or stops and writes it
+    void toggleTrace() {
+        auto& tracer = Tracer::get();
+        if (!tracer.enabled()) {
+            tracer.setThreadName("main");
+            tracer.start();
+            return;
+        }
+        tracer.stop();
+        if (tracer.writeChromeTrace(p_trace_path)) {
+            std::cout << "wrote trace to " << p_trace_path << "\n";
+        } else {
+            std::cerr << "could not write trace " << p_trace_path << "\n";
+        }
+    }
+
+    void startRecording(uint32_t checksum_every) {
+        p_recording = true;
+        p_log = InputLog();
+        p_log.seed = p_seed;
+        p_log.flags = (p_builder.symmetric() ? log_symmetric : 0) | (p_generator ? log_pieces : 0);
+        p_log.checksum_every = checksum_every;
+    }
+
+    static uint64_t fnv1a(uint64_t h, const void* data, size_t n) {
+        auto bytes = (const uint8_t*) data;
+        for (size_t i = 0; i < n; i++) {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    // hash of everything movement, collision and generation depend on
+    uint64_t stateChecksum() {
+        uint64_t h = 14695981039346656037ull;
+        h = fnv1a(h, &p_tick, sizeof(p_tick));
+        for (auto& e : EManager.getEntities()) {
+            auto& e_cVis = e->getComponent<CVisual>();
+            float pos[2] = {e_cVis.local_pos.x, e_cVis.local_pos.y};
+            h = fnv1a(h, pos, sizeof(pos));
+            if (e->hasComponent<CTile>()) {
+                auto& e_cTile = e->getComponent<CTile>();
+                float dims[2] = {e_cTile.w, e_cTile.h};
+                h = fnv1a(h, dims, sizeof(dims));
+                h = fnv1a(h, &e_cTile.wall, sizeof(e_cTile.wall));
+            }
+            if (e->hasComponent<CMovement>()) {
+                for (auto& v : e->getComponent<CMovement>().vel_cache) {
+                    float vel[2] = {v.x, v.y};
+                    h = fnv1a(h, vel, sizeof(vel));
+                }
+            }
+        }
+        return h;
+    }
+
+    // re-simulates a recorded session without a window, stopping at the first checksum mismatch
+    bool replay(const InputLog& log, uint64_t& diverged_at) {
+        auto events = log.decode();
+        size_t next = 0;
+        uint8_t input = 0;
+        while (p_tick < log.ticks) {
+            if ((next < events.size()) && (events[next].tick == p_tick)) {
+                input = events[next++].input;
+            }
+            step(input);
+            if ((p_tick % log.checksum_every) == 0) {
+                size_t idx = (p_tick / log.checksum_every) - 1;
+                if ((idx < log.checksums.size()) && (stateChecksum() != log.checksums[idx])) {
+                    diverged_at = p_tick;
+                    return false;
                 }
             }
-            
-            p_window.display();
         }
+        return true;
+    }
+
+    int fps() {
+        return p_fps;
     }
     
-    std::shared_ptr<Entity> makeWall(float w, float h, float x, float y, bool wall, sf::Color color = sf::Color(255, 255, 255)) {
+    Entity* makeWall(float w, float h, float x, float y, bool wall, sf::Color color = sf::Color(255, 255, 255)) {
         float tile_dim = 8.f;
         auto t = EManager.addEntity(tile);
         t->addComponent<CVisual>(); 
@@ -691,6 +1371,33 @@ public:
         return t;
     }
 
+    void makeDot(int x, int y) {
+        float dot_dim = 2.f;
+        auto d = EManager.addEntity(dot);
+        d->addComponent<CVisual>();
+        d->addComponent<CBBox>();
+        auto& d_cDot = d->addComponent<CDot>();
+        auto& d_cVis = d->getComponent<CVisual>();
+        d_cDot.tile_pos = Vec2(x, y);
+        d_cVis.shape.setSize(sf::Vector2f(dot_dim, dot_dim));
+        d_cVis.shape.setFillColor(sf::Color(255, 184, 151));
+        // centred in the tile
+        d->setPosition(x + (0.5f - dot_dim / 16.f), y + (0.5f - dot_dim / 16.f));
+        p_dot_grid[toGridIndex(Vec2(x, y))] = d;
+    }
+
+    // a dot on every corridor tile but the one the player starts on
+    void makeDots() {
+        auto& grid = p_builder.grid();
+        for (int y = 1; y < p_h - 1; y++) {
+            for (int x = 1; x < p_w - 1; x++) {
+                if ((grid[toGridIndex(Vec2(x, y))] == cell_path) && !((x == p_player_x) && (y == p_player_y))) {
+                    makeDot(x, y);
+                }
+            }
+        }
+    }
+
     void makeBorders(float w, float h, float x, float y) {
         makeWall(w, 1.f, x, y, true, sf::Color(144, 238, 144));
         makeWall(1.f, h, (w - 1), y, true, sf::Color(144, 238, 144));
@@ -699,277 +1406,222 @@ public:
         EManager.update();
     }
 
-    bool hasDoubleThickness(float new_x, float new_y) {         // can be optimised, doesn't need to check every tile
-        float w = 1.f;
-        float h = 1.f;
-        bool u_left = false;
-        bool u_mid = false;
-        bool u_right = false;
-        bool right = false;
-        bool b_right = false;
-        bool b_mid = false;
-        bool b_left = false;
-        bool left = false;
-
-        // TODO use p_entity_grid instead
-        for (auto t : EManager.getEntities(tile)) {
-            auto t_cTile = t->getComponent<CTile>();
-            if (t_cTile.wall) {
-                continue;
-            }
-            auto t_pos = t_cTile.pos;
-
-            if ((t_pos.x == (new_x - w))        && (t_pos.y == (new_y - h))) {
-                u_left = true;
-            } else if ((t_pos.x == new_x)       && (t_pos.y == (new_y - h))) {
-                u_mid = true;
-            } else if ((t_pos.x == (new_x + w)) && (t_pos.y == (new_y - h))) {
-                u_right = true;
-            } else if ((t_pos.x == (new_x + w)) && (t_pos.y == new_y)) {
-                right = true;
-            } else if ((t_pos.x == (new_x + w)) && (t_pos.y == (new_y + h))) {
-                b_right = true;
-            } else if ((t_pos.x == new_x)     && (t_pos.y == (new_y + h))) {
-                b_mid = true;
-            } else if ((t_pos.x == (new_x - w)) && (t_pos.y == (new_y + h))) {
-                b_left = true;
-            } else if ((t_pos.x == (new_x - w)) && (t_pos.y == (new_y))) {
-                left = true;
-            }
-        } 
-        
-        if (left && u_left && u_mid) {
-            return true; 
-        } else if (u_mid && u_right && right) {
-            return true;
-        } else if (right && b_right && b_mid) {
-            return true;
-        } else if (b_mid && b_left && left) {
-            return true;
-        }
+};
 
-        if ((!left) && u_left && (!u_mid)) {
-            return true;
-        } else if ((!u_mid) && u_right && (!right)) {
-            return true;
-        } else if ((!right) && b_right && (!b_mid)) {
-            return true;
-        } else if ((!b_mid) && b_left && (!left)) {
-            return true;
-        }
 
-        if (b_left && b_mid && u_mid && u_left) {
-            return true;
-        } else if (u_left && left && right && u_right) {
-            return true;
-        } else if (u_right && u_mid && b_mid && b_right) {
-            return true;
-        } else if (b_right && right && left && b_left) {
-            return true;
-        } else if (u_left && left && right && b_right) {
-            return true;
-        } else if (u_right && u_mid && b_mid && b_left) {
-            return true;
-        } else if (u_left && u_mid && b_mid && b_right) {
-            return true;
-        } else if (u_right && right && left && b_left) {
-            return true;
-        }
-
-        return false;
 
+// screen: 1680 wide, 930 tall (not including window)
+// 1680.f, 120.f platform
+int replayMain(const std::string& path, const std::string& trace_path) {
+    InputLog log;
+    if (!log.load(path)) {
+        if ((log.version != 0) && (log.version < log_version)) {
+            std::cerr << "input log " << path << " is version " << (int) log.version << ", recorded before dots and levels changed the game, only version "
+                      << (int) log_version << " logs replay\n";
+        } else {
+            std::cerr << "could not read input log " << path << "\n";
+        }
+        return 1;
+    }
+    GameEngine game = GameEngine(log.seed, true);
+    game.setSymmetric(log.flags & log_symmetric);
+    game.setGenerator((log.flags & log_pieces) ? "pieces" : "walk");
+    game.init();
+    if (!trace_path.empty()) {
+        game.setTracePath(trace_path);
+        game.toggleTrace();
+    }
+    uint64_t diverged_at = 0;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = game.replay(log, diverged_at);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!trace_path.empty()) {
+        game.toggleTrace();
+    }
+    double session = (double) log.ticks / game.fps();
+    std::cout << "seed " << log.seed << ", " << log.ticks << " ticks (" << session << "s of play) replayed in "
+              << secs << "s, " << (session / std::max(secs, 1e-9)) << "x real time\n";
+    if (!ok) {
+        std::cout << "diverged at tick " << diverged_at << "\n";
+        return 1;
     }
+    std::cout << log.checksums.size() << " checksums matched\n";
+    return 0;
+}
 
-    bool isIntersecting(CBBox new_t_cBBox, float new_x, float new_y) {
-        auto t_arr = EManager.getEntities(tile);
-        for (auto t : t_arr) {
-            auto t_rect = t->getComponent<CBBox>().rect;
-            if (new_t_cBBox.rect.intersects(t_rect)) {
-                return true;
+// plays levels back to back without a window, eating every dot as soon as the player spawns, and reports
+// what the level changes cost in heap allocations and resident memory once the arena has grown
+int levelsMain(uint32_t seed, bool symmetric, const std::string& generator, uint32_t levels) {
+    GameEngine game = GameEngine(seed, true);
+    game.setSymmetric(symmetric);
+    game.setGenerator(generator);
+    uint64_t before = heap_allocations.load(std::memory_order_relaxed);
+    game.init();
+    uint64_t first = 0;
+    uint64_t rest = 0;
+    uint64_t most = 0;
+    uint32_t allocating = 0;
+    long first_kb = 0;
+    size_t first_slots = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (game.level() < levels) {
+        uint32_t level = game.level();
+        while (game.level() == level) {
+            game.step(0);
+            if (game.playing()) {
+                game.eatDots();
             }
         }
-        return false;
-    }
-
-    bool isOutOfBounds(float new_x, float new_y) {
-        float w = 1.f;
-        float h = 1.f;
-        float uy_bound = 0.f;
-        float ly_bound = 30.f;
-        float rx_bound = 28.f;
-        float lx_bound = 0.f;
-        
-        if (new_y < uy_bound) {
-            return true;
-        } else if ((new_y + h) > ly_bound) {
-            return true;
-        } else if (new_x < lx_bound) {
-            return true;
-        } else if ((new_x + w) > rx_bound) {
-            return true;
+        uint64_t now = heap_allocations.load(std::memory_order_relaxed);
+        uint64_t n = now - before;
+        if (level == 0) {
+            first = n;
+            first_slots = game.arenaSize();
+            first_kb = residentKB();
+            // reading the rss allocates too
+            now = heap_allocations.load(std::memory_order_relaxed);
+        } else {
+            rest += n;
+            most = std::max(most, n);
+            allocating += (n > 0) ? 1 : 0;
         }
-        return false;
+        before = now;
     }
-
-    bool isOnWall(float x, float y) {
-        float w = 1.f;
-        float h = 1.f;
-        float b_w = 1.f;
-        float uy_bound = 0.f;
-        float ly_bound = 30.f;
-        float rx_bound = 28.f;
-        float lx_bound = 0.f;
-
-        if (y == (uy_bound + b_w)) {
-            return true;
-        } else if ((x + w) == (rx_bound - b_w)) {
-            return true;
-        } else if ((y + h) == (ly_bound - b_w)) {
-            return true;
-        } else if (x == (lx_bound + b_w)) {
-            return true;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!counting_allocations) {
+        std::cout << "allocations not counted, build with COUNT_ALLOCATIONS for them\n";
+        std::cout << "level 1: " << first_kb << " kB resident, " << first_slots << " entity slots\n";
+        if (levels > 1) {
+            std::cout << "levels 2-" << levels << ": " << residentKB() << " kB resident, " << game.arenaSize() << " entity slots\n";
+        }
+    } else {
+        std::cout << "level 1: " << first << " allocations, " << first_kb << " kB resident, " << first_slots << " entity slots\n";
+        if (levels > 1) {
+            std::cout << "levels 2-" << levels << ": " << rest << " allocations (" << allocating << " levels allocated, at most "
+                      << most << "), " << residentKB() << " kB resident, " << game.arenaSize() << " entity slots\n";
         }
-        return false;
     }
+    std::cout << levels << " levels in " << secs << "s, " << (secs * 1000 / std::max(levels, 1u)) << " ms/level\n";
+    return 0;
+}
 
-    bool isAlongWall(float x, float y, float new_x, float new_y) {
-        if (isOnWall(x, y) && isOnWall(new_x, new_y)) {
-            return true;
+// usage: main [--seed N] [--symmetric] [--generator walk|pieces] [--record FILE [--checksum-every N]] [--trace FILE]
+//             [--pacing limit|vsync|spin|uncapped] [--fps N] [--capture PATH [--capture-buffers N]]
+//        main --maze FILE [--seed N] [--trace FILE] [--pacing ...] [--fps N] [--capture PATH [--capture-buffers N]]
+//        main --replay FILE [--trace FILE]
+//        main --levels N [--seed N] [--symmetric] [--generator walk|pieces]
+// --generator picks the maze strategy from generator.hpp, the walk is the default and the only one --symmetric applies to
+// --maze plays a maze file from search (mazefile.hpp) on every level, it is never recorded
+// eating the last dot moves on to the next level, --levels plays N of them headless and prints a memory report,
+// with heap allocation counts when built with COUNT_ALLOCATIONS
+// --capture writes every presented frame to PATH from a background thread (see capture.hpp for the formats),
+// frames are dropped when all the buffers are still waiting to be written
+// in the window F1 shows the frame time overlay and F2 starts a trace, pressing it again writes the trace file
+// (trace.json unless --trace named one), --trace records from the start and writes on exit
+int main(int argc, char* argv[]) {   
+    uint32_t seed = std::random_device{}();
+    uint32_t checksum_every = 60;
+    std::string record_path;
+    std::string replay_path;
+    std::string trace_path;
+    std::string capture_path;
+    int capture_buffers = 8;
+    std::string maze_path;
+    bool symmetric = false;
+    std::string generator = "walk";
+    uint32_t levels = 0;
+    paceMode pace = pace_limit;
+    int frame_limit = 144;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--seed") && (i + 1 < argc)) {
+            seed = (uint32_t) std::stoul(argv[++i]);
+        } else if ((arg == "--record") && (i + 1 < argc)) {
+            record_path = argv[++i];
+        } else if ((arg == "--checksum-every") && (i + 1 < argc)) {
+            checksum_every = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--symmetric") {
+            symmetric = true;
+        } else if ((arg == "--generator") && (i + 1 < argc)) {
+            generator = argv[++i];
+        } else if ((arg == "--replay") && (i + 1 < argc)) {
+            replay_path = argv[++i];
+        } else if ((arg == "--trace") && (i + 1 < argc)) {
+            trace_path = argv[++i];
+        } else if ((arg == "--pacing") && (i + 1 < argc)) {
+            std::string mode = argv[++i];
+            if (mode == "vsync") {
+                pace = pace_vsync;
+            } else if (mode == "spin") {
+                pace = pace_spin;
+            } else if (mode == "uncapped") {
+                pace = pace_uncapped;
+            } else {
+                pace = pace_limit;
+            }
+        } else if ((arg == "--fps") && (i + 1 < argc)) {
+            frame_limit = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--maze") && (i + 1 < argc)) {
+            maze_path = argv[++i];
+        } else if ((arg == "--capture") && (i + 1 < argc)) {
+            capture_path = argv[++i];
+        } else if ((arg == "--capture-buffers") && (i + 1 < argc)) {
+            capture_buffers = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--levels") && (i + 1 < argc)) {
+            levels = (uint32_t) std::max(1, std::stoi(argv[++i]));
         }
-        return false;
     }
-
-    std::shared_ptr<Entity> wallBuilder(std::shared_ptr<Entity> t) {
-        float w = 1.f;
-        float h = 1.f;
-        auto& t_cTile = t->getComponent<CTile>();
-        auto& possible_directions = t_cTile.possible_directions;
-        if (possible_directions.size() == 0) {
-            return t;
-        }
-        float x = t_cTile.pos.x;
-        float y = t_cTile.pos.y;
-
-        Vec2 rand = randomDirection(possible_directions);
-        float new_x = x + (rand.x * w);
-        float new_y = y + (rand.y * h);
-
-        auto new_t = makeWall(w, h, new_x, new_y, false);
-        auto& new_t_cBBox = new_t->getComponent<CBBox>();
-        auto& new_t_cTile = new_t->getComponent<CTile>();
-        removeDirection(Vec2(new_x, new_y), t_cTile.pos, possible_directions);
-
-        while (isOutOfBounds(new_x, new_y) || isIntersecting(new_t_cBBox, new_x, new_y) || hasDoubleThickness(new_x, new_y) || isAlongWall(x, y, new_x, new_y)) {
-            if (possible_directions.size() == 0) {
-                new_t->p_isActive = false;
-                return t;
-            }
-            Vec2 new_rand = randomDirection(possible_directions);
-            rand.x = new_rand.x;
-            rand.y = new_rand.y; 
-            new_x = x + (rand.x * w);
-            new_y = y + (rand.y * h);
-            removeDirection(Vec2(new_x, new_y), t_cTile.pos, possible_directions);
-            new_t->setPosition(new_x, new_y);
-        }
-        new_t_cTile.pos.x = new_x;
-        new_t_cTile.pos.y = new_y;
-        return new_t;
+    if (!makeGenerator(generator)) {
+        std::cerr << "unknown generator " << generator << "\n";
+        return 2;
     }
-    
-    bool toPrune(Vec2 curr_pos) {
-        float w = 1.f;
-        float h = 1.f;
-        bool u_left = false;
-        bool u_mid = false;
-        bool u_right = false;
-        bool right = false;
-        bool b_right = false;
-        bool b_mid = false;
-        bool b_left = false;
-        bool left = false;
-        float curr_x = curr_pos.x;
-        float curr_y = curr_pos.y;
- 
-        for (auto t : EManager.getEntities(tile)) {
-            auto t_cTile = t->getComponent<CTile>();
-            auto t_pos = t_cTile.pos;
-            if ((t_cTile.w == w) && (t_cTile.h == h)) {
-                if ((t_pos.x == (curr_x - w))        && (t_pos.y == (curr_y - h))) {
-                    u_left = true;
-                } else if ((t_pos.x == curr_x)       && (t_pos.y == (curr_y - h))) {
-                    u_mid = true;
-                } else if ((t_pos.x == (curr_x + w)) && (t_pos.y == (curr_y - h))) {
-                    u_right = true;
-                } else if ((t_pos.x == (curr_x + w)) && (t_pos.y == curr_y)) {
-                    right = true;
-                } else if ((t_pos.x == (curr_x + w)) && (t_pos.y == (curr_y + h))) {
-                    b_right = true;
-                } else if ((t_pos.x == curr_x)     && (t_pos.y == (curr_y + h))) {
-                    b_mid = true;
-                } else if ((t_pos.x == (curr_x - w)) && (t_pos.y == (curr_y + h))) {
-                    b_left = true;
-                } else if ((t_pos.x == (curr_x - w)) && (t_pos.y == curr_y)) {
-                    left = true;
-                }
-            } /* else if (t_cTile.w == w) {
-                if (t_pos.x == (curr_x - w)) {
-                    u_left = true;
-                    left = true;
-                    b_left = true;
-                } else if (t_pos.x == (curr_x + w)) {
-                    u_right = true;
-                    right = true;
-                    b_right = true;
-                }     
-            } else if (t_cTile.h == h) {
-                if (t_pos.y == (curr_y - h)) {
-                    u_left = true;
-                    u_mid = true;
-                    u_right = true;
-                } else if (t_pos.y == (curr_y + h)) {
-                    b_left = true;
-                    b_mid = true;
-                    b_right = true;
-                } 
-            }*/
-        }
-
-        if (!left && !u_left && !u_mid && !u_right && !right) {
-            return true;
-        } else if (!u_mid && !u_right && !right && !b_right && !b_mid) {
-            return true;
-        } else if (!right && !b_right && !b_mid && !b_left && !left) {
-            return true;
-        } else if (!b_mid && !b_left && !left && !u_left && !u_mid) {
-            return true;
+    if (symmetric && (generator != "walk")) {
+        std::cerr << "--symmetric needs the walk generator\n";
+        return 2;
+    }
+    MazeFile maze;
+    if (!maze_path.empty()) {
+        if (symmetric || (generator != "walk") || !record_path.empty() || !replay_path.empty() || (levels > 0)) {
+            std::cerr << "--maze can't be combined with --symmetric, --generator, --record, --replay or --levels\n";
+            return 2;
         }
-
-        // I shape
-        if (u_left && u_mid && u_right && b_left && b_mid && b_right) {
-            return true;
-        } else if (u_left && left && b_left && u_right && right && b_right) {
-            return true;
+        std::ifstream f(maze_path);
+        if (!readMazeFile(f, maze)) {
+            std::cerr << "could not read maze " << maze_path << "\n";
+            return 1;
         }
-        return false;
     }
 
-    void removeDirection(Vec2 new_pos, Vec2 curr_pos, std::vector<Vec2>& possible_directions) {
-        for (int i = 0; i < possible_directions.size(); i++) {
-            if ((curr_pos + possible_directions[i]) == new_pos) {
-                possible_directions.erase(possible_directions.begin() + i);
-                break;    
-            } 
-        }
+    if (!replay_path.empty()) {
+        return replayMain(replay_path, trace_path);
+    }
+    if (levels > 0) {
+        return levelsMain(seed, symmetric, generator, levels);
     }
-};
-
-
 
-// screen: 1680 wide, 930 tall (not including window)
-// 1680.f, 120.f platform
-int main() {   
-    GameEngine game = GameEngine();
-    game.makeBorders(28.f, 30.f, 0.f, 0.f);
+    GameEngine game = GameEngine(seed);
+    game.setSymmetric(symmetric);
+    game.setGenerator(generator);
+    if (!maze_path.empty() && !game.setMaze(maze)) {
+        std::cerr << "maze " << maze_path << " is not a 28x30 board starting at 3,14\n";
+        return 1;
+    }
+    game.setPacing(pace, frame_limit);
+    if (!capture_path.empty() && !game.startCapture(capture_path, capture_buffers)) {
+        std::cerr << "could not open capture " << capture_path << ", the stream can't be created or a PNG path doesn't have one integer conversion like frames/%05d.png\n";
+        return 1;
+    }
+    if (!record_path.empty()) {
+        game.startRecording(checksum_every);
+    }
+    game.init();
+    if (!trace_path.empty()) {
+        game.setTracePath(trace_path);
+        game.toggleTrace();
+    }
     game.sRender();
-}
\ No newline at end of file
+    if (!record_path.empty() && !game.p_log.save(record_path)) {
+        std::cerr << "could not write input log " << record_path << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,1054 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// headless maze generator shared by the game and the command line tools
+// positions are board tiles: the 1 tile border sits at x = 0, x = w - 1, y = 0 and y = h - 1
+
+enum cellType : uint8_t {
+    cell_empty,
+    cell_path,
+    cell_wall
+};
+
+struct WallRect {
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+enum mazeEventType {
+    ev_none,
+    ev_path,
+    ev_prune,
+    ev_wall,
+    ev_unwall
+};
+
+// what a single generation step changed, so a caller can mirror it
+// ev_unwall removes rects()[index], the last rect then takes its place
+struct MazeEvent {
+    mazeEventType type = ev_none;
+    int x = 0;
+    int y = 0;
+    WallRect rect = {0, 0, 0, 0};
+    int index = -1;
+};
+
+// directions a path tile has not tried yet, kept in the order up, left, down, right
+struct CellDirs {
+    std::array<uint8_t, 4> d = {0, 1, 2, 3};
+    uint8_t n = 4;
+};
+
+const int dir_x[4] = {0, -1, 0, 1};
+const int dir_y[4] = {-1, 0, 1, 0};
+
+class MazeBuilder {
+    int p_w;
+    int p_h;
+    int p_gw;
+    int p_gh;
+    int p_start_x;
+    int p_start_y;
+    bool p_symmetric = false;
+    int p_sw;           // columns the passes scan, the left half in symmetric mode
+    std::mt19937 p_rng;
+    std::vector<uint8_t> p_grid;
+    std::vector<CellDirs> p_dirs;
+    std::vector<WallRect> p_rects;
+
+    // corridor stack, p_walls[0..p_wall_count] is the current branch
+    std::vector<int> p_walls;
+    int p_wall_count = 0;
+    bool p_build_wall = true;
+    bool p_pruned = false;
+    int p_grid_counter = 0;
+    bool p_h_fill = true;
+    bool p_v_fill = true;
+    bool p_bridging = true;
+
+    // regenerate() state: the fill walls over each cell, at most a row run and a column run,
+    // kept up to date as walls are added so a regenerate never has to rebuild it. symmetric boards
+    // widen their walls in mirror() and can't be regenerated, they go without
+    std::vector<std::array<int, 2>> p_cover;
+    bool p_cover_valid = false;
+    bool p_regional = false;
+    std::minstd_rand p_region_rng;
+    WallRect p_region = {0, 0, 0, 0};
+    WallRect p_dirty = {0, 0, 0, 0};
+    std::vector<MazeEvent> p_changes;
+    std::vector<int> p_openings;
+    std::vector<int> p_group_before;
+    std::vector<int> p_group_now;
+    std::vector<int> p_group_map;
+    std::vector<int> p_union;
+    std::vector<int> p_outside;         // union-find over the openings the corridors outside join
+    std::vector<int> p_owner;           // opening an outside tile was reached from, -1 when not reached
+    std::vector<int> p_outside_queue;
+    size_t p_outside_head = 0;
+    std::vector<uint8_t> p_before;
+    std::vector<int> p_keep;            // region tiles the re-roll leaves alone, the start and locked corners
+    std::vector<uint32_t> p_seen;
+    uint32_t p_stamp = 0;
+    std::vector<int> p_queue;
+
+    int randomDirection(CellDirs& dirs) {
+        std::uniform_int_distribution<int> dist(0, (dirs.n - 1));
+        // reseeding the twister costs more than re-rolling a small region, regions use a lighter generator
+        return p_regional ? dist(p_region_rng) : dist(p_rng);
+    }
+
+    void removeDirection(CellDirs& dirs, int i) {
+        for (int j = i; j < dirs.n - 1; j++) {
+            dirs.d[j] = dirs.d[j + 1];
+        }
+        dirs.n--;
+    }
+
+    bool isPath(int x, int y) const {
+        // the right half is the mirror image of the left while generating symmetrically
+        if (p_symmetric && (x > p_sw)) {
+            x = p_w - 1 - x;
+        }
+        if ((x < 1) || (y < 1) || (x > p_gw) || (y > p_gh)) {
+            return false;
+        }
+        return p_grid[toGridIndex(x, y)] == cell_path;
+    }
+
+    void setCell(int x, int y, cellType c) {
+        p_grid[toGridIndex(x, y)] = c;
+        if (c == cell_path) {
+            p_dirs[toGridIndex(x, y)] = CellDirs();
+        }
+    }
+
+public:
+    MazeBuilder(uint32_t seed, int w = 28, int h = 30, int start_x = 3, int start_y = 14)
+        : p_w(w), p_h(h), p_gw(w - 2), p_gh(h - 2), p_start_x(start_x), p_start_y(start_y), p_sw(w - 2) {
+        reset(seed);
+    }
+
+    // generate only the left half and mirror it, needs an even interior width
+    // takes effect from the next reset
+    void setSymmetric(bool symmetric) {
+        p_symmetric = symmetric && ((p_gw % 2) == 0) && (p_start_x <= p_gw / 2);
+    }
+    bool symmetric() const {
+        return p_symmetric;
+    }
+
+    // restart generation with a new seed, reusing the buffers
+    void reset(uint32_t seed) {
+        p_sw = p_symmetric ? (p_gw / 2) : p_gw;
+        p_rng.seed(seed);
+        p_grid.assign(p_gw * p_gh, cell_empty);
+        p_dirs.resize(p_gw * p_gh);
+        p_rects.clear();
+        p_walls.clear();
+        p_wall_count = 0;
+        p_build_wall = true;
+        p_pruned = false;
+        p_grid_counter = 0;
+        p_h_fill = true;
+        p_v_fill = true;
+        p_bridging = p_symmetric;
+        clearCover();
+        setCell(p_start_x, p_start_y, cell_path);
+        p_walls.push_back(toGridIndex(p_start_x, p_start_y));
+    }
+
+    int width() const {
+        return p_w;
+    }
+    int height() const {
+        return p_h;
+    }
+    int startX() const {
+        return p_start_x;
+    }
+    int startY() const {
+        return p_start_y;
+    }
+    bool done() const {
+        return !(p_build_wall || p_h_fill || p_v_fill);
+    }
+    // name of the pass the next step belongs to
+    const char* phase() const {
+        if (p_build_wall) {
+            return "carve";
+        } else if (p_bridging) {
+            return "bridge";
+        } else if (p_h_fill) {
+            return "horizontal_fill";
+        } else if (p_v_fill) {
+            return "vertical_fill";
+        }
+        return "done";
+    }
+    const std::vector<WallRect>& rects() const {
+        return p_rects;
+    }
+    const std::vector<uint8_t>& grid() const {
+        return p_grid;
+    }
+
+    int toGridIndex(int x, int y) const {
+        return ((y - 1) * p_gw) + (x - 1);
+    }
+
+    // board position of an interior grid index
+    void fromGridIndex(int idx, int& x, int& y) const {
+        x = (idx % p_gw) + 1;
+        y = (idx / p_gw) + 1;
+    }
+
+    // cell type at a board position, the border and beyond count as wall
+    cellType at(int x, int y) const {
+        if ((x < 1) || (y < 1) || (x > p_gw) || (y > p_gh)) {
+            return cell_wall;
+        }
+        return (cellType) p_grid[toGridIndex(x, y)];
+    }
+
+    void generate() {
+        MazeEvent ev;
+        while (step(ev)) {}
+    }
+
+    // runs the corridor walk to the end and stops before the fill passes
+    void carveAll() {
+        MazeEvent ev;
+        while (p_build_wall) {
+            carve(ev);
+        }
+    }
+
+    // takes corridors carved elsewhere, p_gh rows of p_gw cells that start stride cells apart,
+    // and leaves only the fill passes to run
+    void loadCorridors(const uint8_t* cells, size_t stride) {
+        for (int y = 0; y < p_gh; y++) {
+            std::copy(cells + (y * stride), cells + (y * stride) + p_gw, p_grid.begin() + (y * p_gw));
+        }
+        p_rects.clear();
+        p_build_wall = false;
+        p_bridging = false;
+        p_h_fill = true;
+        p_v_fill = true;
+        p_grid_counter = 0;
+        clearCover();
+    }
+
+    // takes a finished maze from another generator, same grid layout and rects, regenerate works on it
+    void loadMaze(const std::vector<uint8_t>& grid, const std::vector<WallRect>& rects) {
+        p_grid = grid;
+        p_rects = rects;
+        p_build_wall = false;
+        p_bridging = false;
+        p_h_fill = false;
+        p_v_fill = false;
+        p_grid_counter = 0;
+        clearCover();
+        for (int i = 0; (i < (int) p_rects.size()) && p_cover_valid; i++) {
+            coverRect(i, -1, i);
+        }
+    }
+
+    // one step of the corridor walk: extend the current branch, or prune its dead end and backtrack,
+    // clears p_build_wall once the walk is back at its first tile with nowhere to go
+    void carve(MazeEvent& ev) {
+        int t = p_walls[p_wall_count];
+        int new_t = wallBuilder(t);
+        if (new_t == t) {
+            // try to prune an extra branch
+            int x, y;
+            fromGridIndex(t, x, y);
+            if (toPrune(x, y)) {
+                if (p_wall_count != 0) {
+                    p_wall_count--;
+                    p_grid[t] = cell_empty;
+                    ev.type = ev_prune;
+                    ev.x = x;
+                    ev.y = y;
+                    p_pruned = true;
+                } else {
+                    p_build_wall = false;
+                    p_pruned = false;
+                }
+            // backtrack after pruning branches
+            } else {
+                int prev_t;
+                do {
+                    if (p_wall_count > 0) {
+                        p_wall_count--;
+                        prev_t = p_walls[p_wall_count];
+                        new_t = wallBuilder(prev_t);
+                    } else {
+                        p_build_wall = false;
+                        break;
+                    }
+                } while (new_t == prev_t);
+                p_pruned = false;
+            }
+        } else {
+            p_pruned = false;
+        }
+
+        if (p_build_wall && !p_pruned) {
+            p_wall_count++;
+            if (p_wall_count < (int) p_walls.size()) {
+                p_walls[p_wall_count] = new_t;
+            } else {
+                p_walls.push_back(new_t);
+            }
+            fromGridIndex(new_t, ev.x, ev.y);
+            setCell(ev.x, ev.y, cell_path);
+            ev.type = ev_path;
+        }
+    }
+
+    // advance by one step of the corridor walk or the fill passes, returns false once finished
+    bool step(MazeEvent& ev) {
+        ev.type = ev_none;
+        int grid_size = p_gw * p_gh;
+        if (p_build_wall) {
+            carve(ev);
+        } else if (p_bridging) {
+            // the walk never reached the centre column, carve towards it one tile per step
+            p_bridging = !crossesSeam() && bridge(ev);
+        } else if (p_h_fill) {
+            horizontalFill(ev);
+            if (p_grid_counter == grid_size) {
+                p_h_fill = false;
+                p_grid_counter = 0;
+            }
+        } else if (p_v_fill) {
+            verticalFill(ev);
+            if (p_grid_counter == grid_size) {
+                p_v_fill = false;
+                p_grid_counter = 0;
+                if (p_symmetric) {
+                    mirror();
+                }
+            }
+        }
+        return !done();
+    }
+
+    bool isOutOfBounds(int new_x, int new_y) const {
+        return (new_y < 0) || ((new_y + 1) > p_h) || (new_x < 0) || ((new_x + 1) > p_w);
+    }
+
+    // the new tile would overlap the border or an existing tile
+    bool isIntersecting(int new_x, int new_y) const {
+        if ((new_x < 1) || (new_y < 1) || (new_x > p_sw) || (new_y > p_gh)) {
+            return true;
+        }
+        if (p_regional && ((new_x < p_region.x) || (new_y < p_region.y) || (new_x >= p_region.x + p_region.w) || (new_y >= p_region.y + p_region.h))) {
+            return true;
+        }
+        return p_grid[toGridIndex(new_x, new_y)] != cell_empty;
+    }
+
+    bool isOnWall(int x, int y) const {
+        return (y == 1) || ((x + 1) == (p_w - 1)) || ((y + 1) == (p_h - 1)) || (x == 1);
+    }
+
+    bool isAlongWall(int x, int y, int new_x, int new_y) const {
+        return isOnWall(x, y) && isOnWall(new_x, new_y);
+    }
+
+    bool hasDoubleThickness(int new_x, int new_y) const {
+        bool u_left = isPath(new_x - 1, new_y - 1);
+        bool u_mid = isPath(new_x, new_y - 1);
+        bool u_right = isPath(new_x + 1, new_y - 1);
+        bool right = isPath(new_x + 1, new_y);
+        bool b_right = isPath(new_x + 1, new_y + 1);
+        bool b_mid = isPath(new_x, new_y + 1);
+        bool b_left = isPath(new_x - 1, new_y + 1);
+        bool left = isPath(new_x - 1, new_y);
+        // on the centre column the tile's own mirror sits to its right
+        if (p_symmetric && (new_x == p_sw)) {
+            right = true;
+            u_right = u_mid;
+            b_right = b_mid;
+        }
+
+        if (left && u_left && u_mid) {
+            return true;
+        } else if (u_mid && u_right && right) {
+            return true;
+        } else if (right && b_right && b_mid) {
+            return true;
+        } else if (b_mid && b_left && left) {
+            return true;
+        }
+
+        if ((!left) && u_left && (!u_mid)) {
+            return true;
+        } else if ((!u_mid) && u_right && (!right)) {
+            return true;
+        } else if ((!right) && b_right && (!b_mid)) {
+            return true;
+        } else if ((!b_mid) && b_left && (!left)) {
+            return true;
+        }
+
+        if (b_left && b_mid && u_mid && u_left) {
+            return true;
+        } else if (u_left && left && right && u_right) {
+            return true;
+        } else if (u_right && u_mid && b_mid && b_right) {
+            return true;
+        } else if (b_right && right && left && b_left) {
+            return true;
+        } else if (u_left && left && right && b_right) {
+            return true;
+        } else if (u_right && u_mid && b_mid && b_left) {
+            return true;
+        } else if (u_left && u_mid && b_mid && b_right) {
+            return true;
+        } else if (u_right && right && left && b_left) {
+            return true;
+        }
+        return false;
+    }
+
+    // extend the corridor from grid index t, returns t when every direction is blocked
+    int wallBuilder(int t) {
+        auto& dirs = p_dirs[t];
+        if (dirs.n == 0) {
+            return t;
+        }
+        int x, y;
+        fromGridIndex(t, x, y);
+
+        int i = randomDirection(dirs);
+        int new_x = x + dir_x[dirs.d[i]];
+        int new_y = y + dir_y[dirs.d[i]];
+        removeDirection(dirs, i);
+
+        while (isOutOfBounds(new_x, new_y) || isIntersecting(new_x, new_y) || hasDoubleThickness(new_x, new_y) || isAlongWall(x, y, new_x, new_y)) {
+            if (dirs.n == 0) {
+                return t;
+            }
+            i = randomDirection(dirs);
+            new_x = x + dir_x[dirs.d[i]];
+            new_y = y + dir_y[dirs.d[i]];
+            removeDirection(dirs, i);
+        }
+        return toGridIndex(new_x, new_y);
+    }
+
+    bool toPrune(int curr_x, int curr_y) const {
+        bool u_left = isPath(curr_x - 1, curr_y - 1);
+        bool u_mid = isPath(curr_x, curr_y - 1);
+        bool u_right = isPath(curr_x + 1, curr_y - 1);
+        bool right = isPath(curr_x + 1, curr_y);
+        bool b_right = isPath(curr_x + 1, curr_y + 1);
+        bool b_mid = isPath(curr_x, curr_y + 1);
+        bool b_left = isPath(curr_x - 1, curr_y + 1);
+        bool left = isPath(curr_x - 1, curr_y);
+
+        if (!left && !u_left && !u_mid && !u_right && !right) {
+            return true;
+        } else if (!u_mid && !u_right && !right && !b_right && !b_mid) {
+            return true;
+        } else if (!right && !b_right && !b_mid && !b_left && !left) {
+            return true;
+        } else if (!b_mid && !b_left && !left && !u_left && !u_mid) {
+            return true;
+        }
+
+        // I shape
+        if (u_left && u_mid && u_right && b_left && b_mid && b_right) {
+            return true;
+        } else if (u_left && left && b_left && u_right && right && b_right) {
+            return true;
+        }
+        return false;
+    }
+
+    void horizontalIncrement(int& grid_counter) const {
+        int col_num = grid_counter % p_gw;
+        int col_bottom = col_num + ((p_gh - 1) * p_gw);
+
+        if (grid_counter == col_bottom) {
+            if (col_num != p_sw - 1) {
+                grid_counter = col_num + 1;
+            } else {
+                grid_counter = p_gw * p_gh;
+            }
+        } else {
+            grid_counter += p_gw;
+        }
+    }
+
+    // scan rows from p_grid_counter and cover the next run of 2+ empty cells with a wall
+    void horizontalFill(MazeEvent& ev) {
+        int grid_size = p_gw * p_gh;
+        int seq_counter = 0;
+        for (; p_grid_counter < grid_size; p_grid_counter += 1) {
+            bool filled = p_grid[p_grid_counter] != cell_empty;
+            if (!filled) {
+                seq_counter++;
+            }
+            int x, y;
+            fromGridIndex(p_grid_counter, x, y);
+            // row end, a run reaching the centre column continues into its mirror
+            if (filled || (x == p_sw)) {
+                if ((seq_counter > 1) || (p_symmetric && !filled && (seq_counter == 1))) {
+                    int new_x = x - (seq_counter - 1);
+                    if (filled) {
+                        new_x -= 1;
+                    }
+                    addWall({new_x, y, seq_counter, 1}, ev);
+                    break;
+                } else {
+                    seq_counter = 0;
+                }
+                if (x == p_sw) {
+                    p_grid_counter = toGridIndex(p_gw, y);
+                }
+            }
+        }
+    }
+
+    // scan columns from p_grid_counter and cover the next run of leftover empty cells with a wall
+    void verticalFill(MazeEvent& ev) {
+        int grid_size = p_gw * p_gh;
+        int seq_counter = 0;
+        bool empty_space = false;
+        for (; p_grid_counter < grid_size; ) {
+            uint8_t c = p_grid[p_grid_counter];
+            if (c == cell_empty) {
+                seq_counter++;
+                empty_space = true;
+            } else if (c == cell_wall) {
+                seq_counter++;
+            }
+            int x, y;
+            fromGridIndex(p_grid_counter, x, y);
+            if (y == p_gh) {
+                y += 1;
+            }
+            if ((y == p_gh + 1) || (c == cell_path)) {
+                if ((seq_counter > 1) && (empty_space)) {
+                    addWall({x, y - seq_counter, 1, seq_counter}, ev);
+                    horizontalIncrement(p_grid_counter);
+                    break;
+                }
+                seq_counter = 0;
+                empty_space = false;
+            }
+            horizontalIncrement(p_grid_counter);
+        }
+    }
+
+    bool crossesSeam() const {
+        for (int y = 1; y <= p_gh; y++) {
+            if (p_grid[toGridIndex(p_sw, y)] == cell_path) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // extend the rightmost corridor that can run straight to the centre column by one tile,
+    // returns false when no corridor can reach it without breaking the carving rules
+    bool bridge(MazeEvent& ev) {
+        for (int x = p_sw - 1; x >= 1; x--) {
+            for (int y = 1; y <= p_gh; y++) {
+                if (p_grid[toGridIndex(x, y)] != cell_path) {
+                    continue;
+                }
+                // try the whole run, then keep only its first tile
+                int run = x;
+                while ((run < p_sw) && !isIntersecting(run + 1, y) && !hasDoubleThickness(run + 1, y) && !isAlongWall(run, y, run + 1, y)) {
+                    run++;
+                    p_grid[toGridIndex(run, y)] = cell_path;
+                }
+                bool reached = run == p_sw;
+                for (; run > x; run--) {
+                    p_grid[toGridIndex(run, y)] = cell_empty;
+                }
+                if (reached) {
+                    setCell(x + 1, y, cell_path);
+                    ev.type = ev_path;
+                    ev.x = x + 1;
+                    ev.y = y;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // copy the finished left half onto the right, walls touching the centre join their mirror
+    void mirror() {
+        for (int y = 1; y <= p_gh; y++) {
+            auto row = p_grid.begin() + toGridIndex(1, y);
+            std::reverse_copy(row, row + p_sw, row + p_sw);
+        }
+        size_t n = p_rects.size();
+        for (size_t i = 0; i < n; i++) {
+            WallRect& r = p_rects[i];
+            if (r.x + r.w - 1 == p_sw) {
+                r.w *= 2;
+            } else {
+                p_rects.push_back({p_w - r.x - r.w, r.y, r.w, r.h});
+            }
+        }
+    }
+
+    // record a fill wall and mark the empty cells it covers
+    void addWall(WallRect r, MazeEvent& ev) {
+        p_rects.push_back(r);
+        for (int y = r.y; y < r.y + r.h; y++) {
+            for (int x = r.x; x < r.x + r.w; x++) {
+                if ((x >= 1) && (y >= 1) && (x <= p_gw) && (y <= p_gh) && (p_grid[toGridIndex(x, y)] == cell_empty)) {
+                    p_grid[toGridIndex(x, y)] = cell_wall;
+                }
+            }
+        }
+        if (p_cover_valid) {
+            coverRect((int) p_rects.size() - 1, -1, (int) p_rects.size() - 1);
+        }
+        ev.type = ev_wall;
+        ev.rect = r;
+        ev.index = (int) p_rects.size() - 1;
+    }
+
+    // replaces rect index from with to in the cover slots of rect at, -1 for an empty slot
+    void coverRect(int at, int from, int to) {
+        const WallRect& r = p_rects[at];
+        for (int y = std::max(r.y, 1); y < std::min(r.y + r.h, p_gh + 1); y++) {
+            for (int x = std::max(r.x, 1); x < std::min(r.x + r.w, p_gw + 1); x++) {
+                auto& c = p_cover[toGridIndex(x, y)];
+                if (c[0] == from) {
+                    c[0] = to;
+                } else if (c[1] == from) {
+                    c[1] = to;
+                }
+            }
+        }
+    }
+
+    void clearCover() {
+        p_cover_valid = !p_symmetric;
+        if (p_cover_valid) {
+            p_cover.assign(p_gw * p_gh, {-1, -1});
+            p_seen.resize(p_gw * p_gh);
+            p_owner.assign(p_gw * p_gh, -1);
+        }
+    }
+
+    void growDirty(int x, int y) {
+        int x1 = std::max(p_dirty.x + p_dirty.w, x + 1);
+        int y1 = std::max(p_dirty.y + p_dirty.h, y + 1);
+        p_dirty.x = std::min(p_dirty.x, x);
+        p_dirty.y = std::min(p_dirty.y, y);
+        p_dirty.w = x1 - p_dirty.x;
+        p_dirty.h = y1 - p_dirty.y;
+    }
+
+    // swap-and-pop a fill wall, its cells that no other wall covers are left empty
+    void removeRect(int i) {
+        WallRect r = p_rects[i];
+        coverRect(i, i, -1);
+        for (int y = std::max(r.y, 1); y < std::min(r.y + r.h, p_gh + 1); y++) {
+            for (int x = std::max(r.x, 1); x < std::min(r.x + r.w, p_gw + 1); x++) {
+                int idx = toGridIndex(x, y);
+                if ((p_grid[idx] == cell_wall) && (p_cover[idx][0] == -1) && (p_cover[idx][1] == -1)) {
+                    p_grid[idx] = cell_empty;
+                }
+                growDirty(x, y);
+            }
+        }
+        int last = (int) p_rects.size() - 1;
+        if (i != last) {
+            p_rects[i] = p_rects[last];
+            coverRect(i, last, i);
+        }
+        p_rects.pop_back();
+        MazeEvent ev;
+        ev.type = ev_unwall;
+        ev.rect = r;
+        ev.index = i;
+        p_changes.push_back(ev);
+    }
+
+    // replaces a fill wall reaching into the region with the parts of it outside, at most four,
+    // so the refill stays inside the region
+    void splitRect(int i) {
+        WallRect r = p_rects[i];
+        removeRect(i);
+        int x0 = p_region.x;
+        int y0 = p_region.y;
+        int x1 = p_region.x + p_region.w;
+        int y1 = p_region.y + p_region.h;
+        int mid_y = std::max(r.y, y0);
+        int mid_h = std::min(r.y + r.h, y1) - mid_y;
+        WallRect parts[4] = {
+            {r.x, r.y, r.w, y0 - r.y},
+            {r.x, y1, r.w, r.y + r.h - y1},
+            {r.x, mid_y, x0 - r.x, mid_h},
+            {x1, mid_y, r.x + r.w - x1, mid_h}
+        };
+        MazeEvent ev;
+        for (auto& part : parts) {
+            if ((part.w > 0) && (part.h > 0)) {
+                addWall(part, ev);
+                p_changes.push_back(ev);
+            }
+        }
+    }
+
+    bool inRegion(int x, int y) const {
+        return (x >= p_region.x) && (y >= p_region.y) && (x < p_region.x + p_region.w) && (y < p_region.y + p_region.h);
+    }
+
+    // numbers the openings by which of them are joined through the region's corridors
+    void groupOpenings(std::vector<int>& group) {
+        group.assign(p_openings.size(), -1);
+        int groups = 0;
+        p_stamp++;
+        for (size_t o = 0; o < p_openings.size(); o++) {
+            if (p_seen[p_openings[o]] == p_stamp) {
+                continue;
+            }
+            p_queue.clear();
+            p_queue.push_back(p_openings[o]);
+            p_seen[p_openings[o]] = p_stamp;
+            for (size_t head = 0; head < p_queue.size(); head++) {
+                int u = p_queue[head];
+                auto it = std::lower_bound(p_openings.begin(), p_openings.end(), u);
+                if ((it != p_openings.end()) && (*it == u)) {
+                    group[it - p_openings.begin()] = groups;
+                }
+                int x, y;
+                fromGridIndex(u, x, y);
+                for (int d = 0; d < 4; d++) {
+                    int nx = x + dir_x[d];
+                    int ny = y + dir_y[d];
+                    if ((nx < 1) || (ny < 1) || (nx > p_gw) || (ny > p_gh)) {
+                        continue;
+                    }
+                    int n = toGridIndex(nx, ny);
+                    // outside the region only the openings themselves are walked
+                    bool walkable = inRegion(nx, ny) || std::binary_search(p_openings.begin(), p_openings.end(), n);
+                    if (walkable && (p_grid[n] == cell_path) && (p_seen[n] != p_stamp)) {
+                        p_seen[n] = p_stamp;
+                        p_queue.push_back(n);
+                    }
+                }
+            }
+            groups++;
+        }
+    }
+
+    // walks the corridors outside the region out from every opening at once, up to the next place two of
+    // the walks meet. the outside doesn't change between attempts, so each call carries on where the last
+    // stopped and the walk only goes as far around the region as a check needs. false once it ran out
+    bool growOutside() {
+        while (p_outside_head < p_outside_queue.size()) {
+            int u = p_outside_queue[p_outside_head++];
+            int x, y;
+            fromGridIndex(u, x, y);
+            bool met = false;
+            for (int d = 0; d < 4; d++) {
+                int nx = x + dir_x[d];
+                int ny = y + dir_y[d];
+                if ((nx < 1) || (ny < 1) || (nx > p_gw) || (ny > p_gh) || inRegion(nx, ny)) {
+                    continue;
+                }
+                int n = toGridIndex(nx, ny);
+                if (p_grid[n] != cell_path) {
+                    continue;
+                }
+                if (p_owner[n] == -1) {
+                    p_owner[n] = p_owner[u];
+                    p_outside_queue.push_back(n);
+                    continue;
+                }
+                int a = findUnion(p_outside, p_owner[n]);
+                int b = findUnion(p_outside, p_owner[u]);
+                if (a != b) {
+                    p_outside[a] = b;
+                    met = true;
+                }
+            }
+            if (met) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int findUnion(std::vector<int>& u, int a) {
+        while (u[a] != a) {
+            u[a] = u[u[a]];
+            a = u[a];
+        }
+        return a;
+    }
+
+    // every opening meets the others, through the new corridors inside or the walk outside so far
+    bool allJoined() {
+        int n = (int) p_openings.size();
+        p_union.resize(2 * n);
+        for (int i = 0; i < 2 * n; i++) {
+            p_union[i] = i;
+        }
+        for (int o = 0; o < n; o++) {
+            p_union[findUnion(p_union, o)] = findUnion(p_union, n + p_group_now[o]);
+            p_union[findUnion(p_union, o)] = findUnion(p_union, findUnion(p_outside, o));
+        }
+        int root = findUnion(p_union, 0);
+        for (int o = 1; o < n; o++) {
+            if (findUnion(p_union, o) != root) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // openings the old corridors joined through the region are still joined, so nothing lost its route
+    // to the start. failing that every opening may still meet the others around the outside, which also
+    // keeps the start joined: its old route reached the region through one of them
+    bool openingsJoined() {
+        groupOpenings(p_group_now);
+        p_group_map.assign(p_openings.size(), -1);
+        bool joined = true;
+        for (size_t o = 0; (o < p_openings.size()) && joined; o++) {
+            int& g = p_group_map[p_group_before[o]];
+            if (g == -1) {
+                g = p_group_now[o];
+            } else if (g != p_group_now[o]) {
+                joined = false;
+            }
+        }
+        if (joined || p_openings.empty()) {
+            return true;
+        }
+        while (!allJoined()) {
+            if (!growOutside()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clearRegion() {
+        for (int y = p_region.y; y < p_region.y + p_region.h; y++) {
+            for (int x = p_region.x; x < p_region.x + p_region.w; x++) {
+                int idx = toGridIndex(x, y);
+                if (std::find(p_keep.begin(), p_keep.end(), idx) == p_keep.end()) {
+                    p_grid[idx] = cell_empty;
+                }
+            }
+        }
+    }
+
+    // a corner tile of the region joining corridors on both of its outer sides, with no tile between them
+    // outside, has to stay or the two would touch only at a corner
+    void keepCorner(int x, int y, int dx, int dy) {
+        if (isPath(x, y) && isPath(x + dx, y) && isPath(x, y + dy) && !isPath(x + dx, y + dy)) {
+            p_keep.push_back(toGridIndex(x, y));
+        }
+    }
+
+    // two corridors meeting only at a corner in a window over the region or its edge
+    bool diagonalTouch() const {
+        for (int y = p_region.y - 1; y < p_region.y + p_region.h; y++) {
+            for (int x = p_region.x - 1; x < p_region.x + p_region.w; x++) {
+                bool a = isPath(x, y);
+                bool b = isPath(x + 1, y);
+                bool c = isPath(x, y + 1);
+                bool d = isPath(x + 1, y + 1);
+                if ((a && d && !b && !c) || (b && c && !a && !d)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void fillRegion() {
+        MazeEvent ev;
+        int x0 = p_region.x;
+        int y0 = p_region.y;
+        int x1 = p_region.x + p_region.w;
+        int y1 = p_region.y + p_region.h;
+        // rows first as in the full fill, runs of 2+ empty cells become one wall
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1;) {
+                int run = 0;
+                while ((x + run < x1) && (p_grid[toGridIndex(x + run, y)] == cell_empty)) {
+                    run++;
+                }
+                if (run > 1) {
+                    addWall({x, y, run, 1}, ev);
+                    p_changes.push_back(ev);
+                }
+                x += std::max(run, 1);
+            }
+        }
+        // then whatever is left down each column, a new wall never overlaps an old one
+        for (int x = x0; x < x1; x++) {
+            for (int y = y0; y < y1;) {
+                int run = 0;
+                while ((y + run < y1) && (p_grid[toGridIndex(x, y + run)] == cell_empty)) {
+                    run++;
+                }
+                if (run > 0) {
+                    addWall({x, y, 1, run}, ev);
+                    p_changes.push_back(ev);
+                }
+                y += std::max(run, 1);
+            }
+        }
+    }
+
+    // re-roll one rectangle of a finished board: clear it, carve new corridors from the corridors touching
+    // its edge and wall in the cells left empty. fill walls reaching into the region are cut back to its
+    // edge, so the work follows the region's size and the length of those walls rather than the board's
+    // the walk is retried until every pair of openings the old corridors joined through the region is
+    // joined again or every opening still meets the others around the outside, with no two corridors
+    // meeting only at a corner. if no attempt manages that the old corridors are put back and it returns false
+    // changes() lists what happened in order, for callers keeping their own copy of the board
+    bool regenerate(WallRect region, uint32_t seed, int attempts = 32) {
+        p_changes.clear();
+        int x0 = std::max(region.x, 1);
+        int y0 = std::max(region.y, 1);
+        int x1 = std::min(region.x + region.w, p_gw + 1);
+        int y1 = std::min(region.y + region.h, p_gh + 1);
+        // symmetric boards would need the mirrored region re-rolled in step, not supported
+        if (!done() || p_symmetric || (x0 >= x1) || (y0 >= y1)) {
+            return false;
+        }
+        p_region = {x0, y0, x1 - x0, y1 - y0};
+        p_dirty = p_region;
+        p_keep.clear();
+        if (inRegion(p_start_x, p_start_y)) {
+            p_keep.push_back(toGridIndex(p_start_x, p_start_y));
+        }
+        keepCorner(x0, y0, -1, -1);
+        keepCorner(x1 - 1, y0, 1, -1);
+        keepCorner(x0, y1 - 1, -1, 1);
+        keepCorner(x1 - 1, y1 - 1, 1, 1);
+
+        // corridors just outside each edge, and the start tile if the region holds it
+        p_openings.clear();
+        auto opening = [&](int x, int y) {
+            if ((x >= 1) && (y >= 1) && (x <= p_gw) && (y <= p_gh) && (p_grid[toGridIndex(x, y)] == cell_path)) {
+                p_openings.push_back(toGridIndex(x, y));
+            }
+        };
+        for (int x = x0; x < x1; x++) {
+            opening(x, y0 - 1);
+            opening(x, y1);
+        }
+        for (int y = y0; y < y1; y++) {
+            opening(x0 - 1, y);
+            opening(x1, y);
+        }
+        if (inRegion(p_start_x, p_start_y)) {
+            p_openings.push_back(toGridIndex(p_start_x, p_start_y));
+        }
+        std::sort(p_openings.begin(), p_openings.end());
+        p_openings.erase(std::unique(p_openings.begin(), p_openings.end()), p_openings.end());
+        groupOpenings(p_group_before);
+
+        p_before.clear();
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                int idx = toGridIndex(x, y);
+                p_before.push_back(p_grid[idx]);
+                while ((p_cover[idx][0] != -1) || (p_cover[idx][1] != -1)) {
+                    splitRect((p_cover[idx][0] != -1) ? p_cover[idx][0] : p_cover[idx][1]);
+                }
+            }
+        }
+        clearRegion();
+
+        p_outside.resize(p_openings.size());
+        p_outside_queue.clear();
+        p_outside_head = 0;
+        for (int o = 0; o < (int) p_openings.size(); o++) {
+            p_outside[o] = o;
+            p_owner[p_openings[o]] = o;
+            p_outside_queue.push_back(p_openings[o]);
+        }
+        p_region_rng.seed(seed);
+        p_regional = true;
+        bool joined = false;
+        for (int a = 0; (a < attempts) && !joined; a++) {
+            if (a > 0) {
+                clearRegion();
+            }
+            MazeEvent ev;
+            for (int o : p_openings) {
+                p_dirs[o] = CellDirs();
+                p_walls.assign(1, o);
+                p_wall_count = 0;
+                p_build_wall = true;
+                p_pruned = false;
+                while (p_build_wall) {
+                    carve(ev);
+                }
+            }
+            joined = openingsJoined() && !diagonalTouch();
+        }
+        p_regional = false;
+        if (!joined) {
+            size_t k = 0;
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                    p_grid[toGridIndex(x, y)] = (p_before[k++] == cell_path) ? cell_path : cell_empty;
+                }
+            }
+        }
+
+        size_t k = 0;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                bool was = p_before[k++] == cell_path;
+                bool now = p_grid[toGridIndex(x, y)] == cell_path;
+                if (was != now) {
+                    MazeEvent ev;
+                    ev.type = now ? ev_path : ev_prune;
+                    ev.x = x;
+                    ev.y = y;
+                    p_changes.push_back(ev);
+                }
+            }
+        }
+        for (int u : p_outside_queue) {
+            p_owner[u] = -1;
+        }
+        fillRegion();
+        return joined;
+    }
+
+    const std::vector<MazeEvent>& changes() const {
+        return p_changes;
+    }
+    // cells the last regenerate touched: the region and the old fill walls that reached into it
+    WallRect dirtyArea() const {
+        return p_dirty;
+    }
+    // a fill wall covering the cell, -1 if none or on a symmetric board
+    int rectAt(int x, int y) const {
+        if (!p_cover_valid) {
+            return -1;
+        }
+        auto& c = p_cover[toGridIndex(x, y)];
+        return (c[0] != -1) ? c[0] : c[1];
+    }
+};
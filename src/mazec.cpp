@@ -0,0 +1,172 @@
+#include "protocol.hpp"
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// client and load generator for mazed
+// usage: mazec [--socket PATH] [--count N] [--from SEED] [--size WxH] [--format grid|rects]
+//              [--out FILE] [--print] [--stats]
+//        mazec --load [--connections C] [--requests R] plus the request options above
+
+bool request(int fd, const MazeRequest& r, Packet& reply) {
+    Packet p;
+    writeRequest(p, r);
+    return sendMessage(fd, p) && recvMessage(fd, reply);
+}
+
+void printStats(const ServerStats& s) {
+    double secs = std::max(s.uptime_ms, (uint64_t) 1) / 1000.0;
+    std::cout << "uptime " << secs << "s, " << s.requests << " requests, " << s.mazes << " mazes ("
+              << (uint64_t) (s.mazes / secs) << " mazes/s), " << s.bytes_out << " bytes sent\n";
+    std::cout << "pool " << s.pool_hits << " hits, " << s.pool_misses << " misses\n";
+    std::cout << "latency us: p50 " << s.p50_us << ", p90 " << s.p90_us << ", p99 " << s.p99_us
+              << ", p99.9 " << s.p999_us << ", max " << s.max_us << "\n";
+}
+
+// prints the first maze of a fmt_grid reply
+void printMaze(Packet& reply) {
+    uint64_t count, seed, w, h, len;
+    if (!reply.get(count, 4) || (count == 0) || !reply.get(seed, 8) || !reply.get(w, 2) || !reply.get(h, 2) || !reply.get(len, 4)) {
+        return;
+    }
+    std::cout << "seed " << seed << "\n";
+    for (uint64_t y = 0; y < h; y++) {
+        for (uint64_t x = 0; x < w; x++) {
+            bool corridor = false;
+            if ((x > 0) && (y > 0) && (x < w - 1) && (y < h - 1)) {
+                uint64_t i = ((y - 1) * (w - 2)) + (x - 1);
+                corridor = (reply.data[reply.pos + (i / 8)] >> (i % 8)) & 1;
+            }
+            std::cout << (corridor ? '.' : '#');
+        }
+        std::cout << "\n";
+    }
+}
+
+int loadTest(const std::string& path, const MazeRequest& r, int connections, int requests) {
+    LatencyHistogram latency;
+    std::atomic<uint64_t> failed{0};
+    std::vector<std::thread> clients;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < connections; c++) {
+        clients.emplace_back([&, c]() {
+            int fd = connectTo(path);
+            if (fd < 0) {
+                failed += requests;
+                return;
+            }
+            MazeRequest cr = r;
+            Packet reply;
+            for (int i = 0; i < requests; i++) {
+                if (r.seed_from != any_seed) {
+                    cr.seed_from = r.seed_from + ((uint64_t) ((c * requests) + i) * r.count);
+                }
+                auto sent = std::chrono::steady_clock::now();
+                if (!request(fd, cr, reply) || reply.data.empty()) {
+                    failed++;
+                    continue;
+                }
+                latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent).count());
+            }
+            ::close(fd);
+        });
+    }
+    for (auto& c : clients) {
+        c.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t done = latency.count();
+    std::cout << connections << " connections x " << requests << " requests of " << r.count << " mazes: "
+              << done << " ok, " << failed << " failed in " << secs << "s\n";
+    std::cout << (uint64_t) (done / secs) << " requests/s, " << (uint64_t) (done * r.count / secs) << " mazes/s\n";
+    std::cout << "round trip us: p50 " << latency.percentile(0.50) << ", p90 " << latency.percentile(0.90)
+              << ", p99 " << latency.percentile(0.99) << ", p99.9 " << latency.percentile(0.999)
+              << ", max " << latency.max() << "\n";
+    return (failed == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = default_socket_path;
+    std::string out_path;
+    MazeRequest r;
+    bool load = false;
+    bool print = false;
+    int connections = 8;
+    int requests = 1000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "--socket") && has_value) {
+            path = argv[++i];
+        } else if ((arg == "--count") && has_value) {
+            r.count = (uint32_t) std::stoul(argv[++i]);
+        } else if ((arg == "--from") && has_value) {
+            r.seed_from = std::stoull(argv[++i]);
+        } else if ((arg == "--size") && has_value) {
+            std::string s = argv[++i];
+            auto x = s.find('x');
+            if (x == std::string::npos) {
+                std::cerr << "--size expects WxH\n";
+                return 2;
+            }
+            r.width = (uint16_t) std::stoi(s.substr(0, x));
+            r.height = (uint16_t) std::stoi(s.substr(x + 1));
+        } else if ((arg == "--format") && has_value) {
+            r.format = (std::string(argv[++i]) == "rects") ? fmt_rects : fmt_grid;
+        } else if ((arg == "--out") && has_value) {
+            out_path = argv[++i];
+        } else if ((arg == "--connections") && has_value) {
+            connections = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--requests") && has_value) {
+            requests = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--stats") {
+            r.op = op_stats;
+        } else if (arg == "--load") {
+            load = true;
+        } else if (arg == "--print") {
+            print = true;
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 2;
+        }
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (load) {
+        return loadTest(path, r, connections, requests);
+    }
+
+    int fd = connectTo(path);
+    if (fd < 0) {
+        std::cerr << "could not connect to " << path << "\n";
+        return 1;
+    }
+    Packet reply;
+    if (!request(fd, r, reply) || reply.data.empty()) {
+        std::cerr << "request failed\n";
+        return 1;
+    }
+    ::close(fd);
+
+    if (r.op == op_stats) {
+        ServerStats s;
+        if (!readStats(reply, s)) {
+            return 1;
+        }
+        printStats(s);
+        return 0;
+    }
+    std::cout << r.count << " mazes, " << reply.data.size() << " bytes\n";
+    if (!out_path.empty()) {
+        std::ofstream f(out_path, std::ios::binary);
+        f.write((const char*) reply.data.data(), reply.data.size());
+    }
+    if (print && (r.format == fmt_grid)) {
+        printMaze(reply);
+    }
+    return 0;
+}
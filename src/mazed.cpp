@@ -0,0 +1,302 @@
+#include "maze.hpp"
+#include "protocol.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// maze generation daemon on a Unix domain socket, see protocol.hpp for the wire format
+// usage: mazed [--socket PATH] [--threads N] [--pool N]
+
+const int min_size = 6;
+const int max_size = 1024;
+
+// generator threads shared by every connection, idle workers top up a pool of ready
+// default size mazes so requests for any seed are answered without generating
+class Engine {
+    std::vector<std::thread> p_workers;
+    std::mutex p_mutex;
+    std::condition_variable p_cv;
+    std::deque<std::function<void(MazeBuilder&)>> p_jobs;
+    std::deque<PackedMaze> p_pool;
+    size_t p_pool_target;
+    uint64_t p_next_seed;
+    bool p_stop = false;
+
+    void work() {
+        MazeBuilder m(0);
+        for (;;) {
+            std::function<void(MazeBuilder&)> job;
+            uint64_t refill_seed = 0;
+            {
+                std::unique_lock<std::mutex> lock(p_mutex);
+                p_cv.wait(lock, [&]() {
+                    return p_stop || !p_jobs.empty() || (p_pool.size() < p_pool_target);
+                });
+                if (p_stop) {
+                    return;
+                }
+                if (!p_jobs.empty()) {
+                    job = std::move(p_jobs.front());
+                    p_jobs.pop_front();
+                } else {
+                    refill_seed = p_next_seed++;
+                }
+            }
+            if (job) {
+                job(m);
+                continue;
+            }
+            PackedMaze packed;
+            m.reset((uint32_t) refill_seed);
+            m.generate();
+            packMaze(m, refill_seed, packed);
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_pool.push_back(std::move(packed));
+        }
+    }
+
+public:
+    Engine(int threads, size_t pool_target)
+        : p_pool_target(pool_target), p_next_seed(std::random_device{}()) {
+        for (int i = 0; i < threads; i++) {
+            p_workers.emplace_back([this]() {
+                work();
+            });
+        }
+    }
+    ~Engine() {
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_stop = true;
+        }
+        p_cv.notify_all();
+        for (auto& w : p_workers) {
+            w.join();
+        }
+    }
+
+    // takes up to n pooled mazes, returns how many were available
+    size_t takePooled(size_t n, std::vector<PackedMaze>& out) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        size_t taken = std::min(n, p_pool.size());
+        for (size_t i = 0; i < taken; i++) {
+            out.push_back(std::move(p_pool.front()));
+            p_pool.pop_front();
+        }
+        p_cv.notify_all();
+        return taken;
+    }
+
+    uint64_t reserveSeeds(uint64_t n) {
+        std::lock_guard<std::mutex> lock(p_mutex);
+        uint64_t first = p_next_seed;
+        p_next_seed += n;
+        return first;
+    }
+
+    // generates out[first..] for seeds seed_from.., split across the workers, and waits for all of them
+    void generate(std::vector<PackedMaze>& out, size_t first, uint64_t seed_from, int w, int h) {
+        const size_t chunk = 16;
+        size_t n = out.size() - first;
+        size_t chunks = (n + chunk - 1) / chunk;
+        if (chunks == 0) {
+            return;
+        }
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+        size_t remaining = chunks;
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            for (size_t c = 0; c < chunks; c++) {
+                size_t lo = first + (c * chunk);
+                size_t hi = std::min(out.size(), lo + chunk);
+                p_jobs.push_back([&, lo, hi](MazeBuilder& pooled) {
+                    auto run = [&](MazeBuilder& m) {
+                        for (size_t i = lo; i < hi; i++) {
+                            uint64_t seed = seed_from + (i - first);
+                            m.reset((uint32_t) seed);
+                            m.generate();
+                            packMaze(m, seed, out[i]);
+                        }
+                    };
+                    if ((w == pooled.width()) && (h == pooled.height())) {
+                        run(pooled);
+                    } else {
+                        MazeBuilder sized(0, w, h, std::min(3, w - 2), std::min(14, h - 2));
+                        run(sized);
+                    }
+                    std::lock_guard<std::mutex> done(done_mutex);
+                    if (--remaining == 0) {
+                        done_cv.notify_one();
+                    }
+                });
+            }
+        }
+        p_cv.notify_all();
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&]() {
+            return remaining == 0;
+        });
+    }
+};
+
+class Server {
+    Engine& p_engine;
+    std::chrono::steady_clock::time_point p_started = std::chrono::steady_clock::now();
+    LatencyHistogram p_latency;
+    std::atomic<uint64_t> p_requests{0};
+    std::atomic<uint64_t> p_mazes{0};
+    std::atomic<uint64_t> p_bytes_out{0};
+    std::atomic<uint64_t> p_pool_hits{0};
+    std::atomic<uint64_t> p_pool_misses{0};
+
+    bool handleGenerate(const MazeRequest& r, Packet& reply) {
+        if ((r.width < min_size) || (r.height < min_size) || (r.width > max_size) || (r.height > max_size) || (r.count > max_batch)) {
+            return false;
+        }
+        // checked before generating, a reply past max_message is one no client would read
+        if (replyBound(r) > max_message) {
+            return false;
+        }
+        std::vector<PackedMaze> mazes;
+        mazes.reserve(r.count);
+        uint64_t seed_from = r.seed_from;
+        if (r.seed_from == any_seed) {
+            if ((r.width == 28) && (r.height == 30)) {
+                size_t hits = p_engine.takePooled(r.count, mazes);
+                p_pool_hits += hits;
+                p_pool_misses += r.count - hits;
+            }
+            seed_from = p_engine.reserveSeeds(r.count - mazes.size());
+        }
+        size_t first = mazes.size();
+        mazes.resize(r.count);
+        p_engine.generate(mazes, first, seed_from, r.width, r.height);
+
+        reply.put(mazes.size(), 4);
+        for (auto& m : mazes) {
+            writeMaze(reply, m, r.format);
+        }
+        // the bound is what keeps replies under max_message, never send past it
+        if (reply.data.size() > replyBound(r)) {
+            return false;
+        }
+        p_mazes += mazes.size();
+        return true;
+    }
+
+    void handleStats(Packet& reply) {
+        ServerStats s;
+        s.uptime_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - p_started).count();
+        s.requests = p_requests;
+        s.mazes = p_mazes;
+        s.bytes_out = p_bytes_out;
+        s.pool_hits = p_pool_hits;
+        s.pool_misses = p_pool_misses;
+        s.p50_us = p_latency.percentile(0.50);
+        s.p90_us = p_latency.percentile(0.90);
+        s.p99_us = p_latency.percentile(0.99);
+        s.p999_us = p_latency.percentile(0.999);
+        s.max_us = p_latency.max();
+        writeStats(reply, s);
+    }
+
+public:
+    Server(Engine& engine)
+        : p_engine(engine) {}
+
+    void serve(int fd) {
+        Packet request;
+        Packet reply;
+        while (recvMessage(fd, request)) {
+            auto start = std::chrono::steady_clock::now();
+            MazeRequest r;
+            reply.data.clear();
+            if (!readRequest(request, r)) {
+                break;
+            }
+            bool ok = true;
+            if (r.op == op_stats) {
+                handleStats(reply);
+            } else if (r.op == op_generate) {
+                ok = handleGenerate(r, reply);
+            } else {
+                ok = false;
+            }
+            // an empty reply tells the client its request was rejected
+            if (!ok) {
+                reply.data.clear();
+            }
+            if (!sendMessage(fd, reply)) {
+                break;
+            }
+            p_bytes_out += reply.data.size() + 4;
+            if (r.op == op_generate) {
+                p_requests++;
+                p_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        ::close(fd);
+    }
+};
+
+std::string socket_path = default_socket_path;
+
+void onSignal(int) {
+    ::unlink(socket_path.c_str());
+    _exit(0);
+}
+
+int main(int argc, char* argv[]) {
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t pool = 4096;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--socket") && (i + 1 < argc)) {
+            socket_path = argv[++i];
+        } else if ((arg == "--threads") && (i + 1 < argc)) {
+            threads = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--pool") && (i + 1 < argc)) {
+            pool = std::stoul(argv[++i]);
+        } else {
+            std::cerr << "usage: mazed [--socket PATH] [--threads N] [--pool N]\n";
+            return 2;
+        }
+    }
+
+    sockaddr_un addr;
+    if (!socketAddress(socket_path, addr)) {
+        std::cerr << "socket path too long: " << socket_path << "\n";
+        return 1;
+    }
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(socket_path.c_str());
+    if ((listen_fd < 0) || (::bind(listen_fd, (sockaddr*) &addr, sizeof(addr)) != 0) || (::listen(listen_fd, 128) != 0)) {
+        std::cerr << "could not listen on " << socket_path << "\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Engine engine(threads, pool);
+    Server server(engine);
+    std::cout << "mazed listening on " << socket_path << " with " << threads << " generator threads, pool of " << pool << "\n";
+    for (;;) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        std::thread([&server, fd]() {
+            server.serve(fd);
+        }).detach();
+    }
+}
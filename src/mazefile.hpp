@@ -0,0 +1,97 @@
+#pragma once
+#include "maze.hpp"
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// finished mazes as text, written by search and loaded by main --maze and verify --maze
+//   maze W H START_X START_Y
+//   H rows of W characters: '#' wall or border, '.' corridor, 'S' the start tile
+//   rects N
+//   N lines of x y w h, the fill walls in board tiles
+
+struct MazeFile {
+    int w = 0;
+    int h = 0;
+    int start_x = 0;
+    int start_y = 0;
+    std::vector<uint8_t> grid;      // interior cells, MazeBuilder layout
+    std::vector<WallRect> walls;
+
+    int width() const {
+        return w;
+    }
+    int height() const {
+        return h;
+    }
+    int startX() const {
+        return start_x;
+    }
+    int startY() const {
+        return start_y;
+    }
+    const std::vector<WallRect>& rects() const {
+        return walls;
+    }
+    cellType at(int x, int y) const {
+        if ((x < 1) || (y < 1) || (x > w - 2) || (y > h - 2)) {
+            return cell_wall;
+        }
+        return (cellType) grid[((y - 1) * (w - 2)) + (x - 1)];
+    }
+};
+
+// a MazeBuilder, a MazeGenerator or anything else with their accessors
+template <typename Maze>
+void writeMazeFile(std::ostream& out, const Maze& m) {
+    out << "maze " << m.width() << " " << m.height() << " " << m.startX() << " " << m.startY() << "\n";
+    for (int y = 0; y < m.height(); y++) {
+        for (int x = 0; x < m.width(); x++) {
+            if ((x == m.startX()) && (y == m.startY())) {
+                out << 'S';
+            } else {
+                out << ((m.at(x, y) == cell_path) ? '.' : '#');
+            }
+        }
+        out << "\n";
+    }
+    out << "rects " << m.rects().size() << "\n";
+    for (auto& r : m.rects()) {
+        out << r.x << " " << r.y << " " << r.w << " " << r.h << "\n";
+    }
+}
+
+// false on anything malformed, including rects outside the interior
+inline bool readMazeFile(std::istream& in, MazeFile& f) {
+    std::string word;
+    if (!(in >> word >> f.w >> f.h >> f.start_x >> f.start_y) || (word != "maze") || (f.w < 3) || (f.h < 3) ||
+        (f.start_x < 1) || (f.start_y < 1) || (f.start_x > f.w - 2) || (f.start_y > f.h - 2)) {
+        return false;
+    }
+    f.grid.assign((f.w - 2) * (f.h - 2), cell_empty);
+    for (int y = 0; y < f.h; y++) {
+        std::string row;
+        if (!(in >> row) || ((int) row.size() != f.w)) {
+            return false;
+        }
+        for (int x = 1; (y > 0) && (y < f.h - 1) && (x < f.w - 1); x++) {
+            f.grid[((y - 1) * (f.w - 2)) + (x - 1)] = ((row[x] == '.') || (row[x] == 'S')) ? cell_path : cell_empty;
+        }
+    }
+    size_t n = 0;
+    if (!(in >> word >> n) || (word != "rects") || (n > f.grid.size())) {
+        return false;
+    }
+    f.walls.clear();
+    for (size_t i = 0; i < n; i++) {
+        WallRect r;
+        if (!(in >> r.x >> r.y >> r.w >> r.h) || (r.w <= 0) || (r.h <= 0) || (r.x < 1) || (r.y < 1) ||
+            (r.x + r.w > f.w - 1) || (r.y + r.h > f.h - 1)) {
+            return false;
+        }
+        f.walls.push_back(r);
+    }
+    return true;
+}
@@ -0,0 +1,339 @@
+#pragma once
+#include "maze.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// weights for MazeMetrics::score, each metric is normalised to roughly 0..1 before weighting
+// a single dead end outweighs a few junctions, and the distance only tips close calls, weighted
+// any heavier the search trades every junction for one long winding corridor
+struct MetricWeights {
+    double dead_ends = -40.0;
+    double junctions = 2.0;
+    double balance = -3.0;
+    double distance = 0.2;
+};
+
+// corridor layout of a finished maze with dead ends, junctions, left/right balance and
+// distance from the start kept up to date as single tiles are opened or closed
+// every update only touches the tiles whose values actually change
+class MazeMetrics {
+    int p_w = 0;
+    int p_h = 0;
+    int p_start = 0;
+    std::vector<uint8_t> p_open;
+    std::vector<int> p_dist;
+    std::vector<uint32_t> p_mark;
+    uint32_t p_stamp = 0;
+    std::vector<int> p_queue;
+    std::vector<std::pair<int, int>> p_heap;
+    std::vector<std::pair<int, int>> p_saved;
+
+    int p_cells = 0;
+    int p_dead_ends = 0;
+    int p_junctions = 0;
+    int p_left = 0;
+    int p_right = 0;
+    int64_t p_dist_sum = 0;
+
+    // the border is never open, so interior tiles can index their neighbours directly
+    int degree(int i) const {
+        return p_open[i - 1] + p_open[i + 1] + p_open[i - p_w] + p_open[i + p_w];
+    }
+    void count(int i, int sign) {
+        if (!p_open[i]) {
+            return;
+        }
+        int d = degree(i);
+        if (d == 1) {
+            p_dead_ends += sign;
+        } else if (d >= 3) {
+            p_junctions += sign;
+        }
+    }
+    void countAround(int i, int sign) {
+        count(i, sign);
+        count(i - 1, sign);
+        count(i + 1, sign);
+        count(i - p_w, sign);
+        count(i + p_w, sign);
+    }
+    void countSide(int i, int sign) {
+        p_cells += sign;
+        if ((i % p_w) < (p_w / 2)) {
+            p_left += sign;
+        } else {
+            p_right += sign;
+        }
+    }
+    // the 2x2 window with i at its top left is a corridor block or two corridors touching only diagonally
+    bool isBadWindow(int i) const {
+        int a = p_open[i];
+        int b = p_open[i + 1];
+        int c = p_open[i + p_w];
+        int d = p_open[i + p_w + 1];
+        return (a && b && c && d) || (a && d && !b && !c) || (b && c && !a && !d);
+    }
+    // an interior wall tile with corridor on all four sides
+    bool isIsolatedWall(int i) const {
+        int x = i % p_w;
+        int y = i / p_w;
+        if ((x < 1) || (y < 1) || (x > p_w - 2) || (y > p_h - 2) || p_open[i]) {
+            return false;
+        }
+        return p_open[i - 1] && p_open[i + 1] && p_open[i - p_w] && p_open[i + p_w];
+    }
+    // setting tile i to open would keep the shapes the generator never makes out of the maze
+    bool shapeAllowed(int i, uint8_t open) {
+        uint8_t was = p_open[i];
+        p_open[i] = open;
+        bool bad = isBadWindow(i) || isBadWindow(i - 1) || isBadWindow(i - p_w) || isBadWindow(i - p_w - 1)
+                || isIsolatedWall(i) || isIsolatedWall(i - 1) || isIsolatedWall(i + 1) || isIsolatedWall(i - p_w) || isIsolatedWall(i + p_w);
+        p_open[i] = was;
+        return !bad;
+    }
+
+    bool openTile(int i) {
+        const int nbr[4] = {i - p_w, i - 1, i + p_w, i + 1};
+        int best = INT_MAX;
+        for (int n : nbr) {
+            if (p_open[n]) {
+                best = std::min(best, p_dist[n] + 1);
+            }
+        }
+        if ((best == INT_MAX) || !shapeAllowed(i, 1)) {
+            return false;
+        }
+        countAround(i, -1);
+        p_open[i] = 1;
+        countSide(i, 1);
+        countAround(i, 1);
+        p_dist[i] = best;
+        p_dist_sum += best;
+
+        // distances can only shrink, relax outwards from the new tile
+        p_queue.clear();
+        p_queue.push_back(i);
+        for (size_t head = 0; head < p_queue.size(); head++) {
+            int u = p_queue[head];
+            const int next[4] = {u - p_w, u - 1, u + p_w, u + 1};
+            for (int v : next) {
+                if (p_open[v] && (p_dist[v] > p_dist[u] + 1)) {
+                    p_dist_sum -= p_dist[v] - (p_dist[u] + 1);
+                    p_dist[v] = p_dist[u] + 1;
+                    p_queue.push_back(v);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool closeTile(int i) {
+        if (!shapeAllowed(i, 0)) {
+            return false;
+        }
+        countAround(i, -1);
+        p_open[i] = 0;
+        countAround(i, 1);
+
+        // collect the tiles whose every shortest route ran through i, in distance order
+        p_stamp++;
+        p_mark[i] = p_stamp;
+        p_queue.clear();
+        p_queue.push_back(i);
+        for (size_t head = 0; head < p_queue.size(); head++) {
+            int u = p_queue[head];
+            const int next[4] = {u - p_w, u - 1, u + p_w, u + 1};
+            for (int v : next) {
+                if (!p_open[v] || (p_mark[v] == p_stamp) || (p_dist[v] != p_dist[u] + 1)) {
+                    continue;
+                }
+                bool supported = false;
+                const int back[4] = {v - p_w, v - 1, v + p_w, v + 1};
+                for (int b : back) {
+                    if (p_open[b] && (p_mark[b] != p_stamp) && (p_dist[b] == p_dist[v] - 1)) {
+                        supported = true;
+                        break;
+                    }
+                }
+                if (!supported) {
+                    p_mark[v] = p_stamp;
+                    p_queue.push_back(v);
+                }
+            }
+        }
+
+        p_saved.clear();
+        for (int v : p_queue) {
+            p_saved.push_back({v, p_dist[v]});
+            p_dist_sum -= p_dist[v];
+            p_dist[v] = -1;
+        }
+
+        // re-settle the affected tiles from their unaffected neighbours, nearest first
+        p_heap.clear();
+        for (size_t k = 1; k < p_queue.size(); k++) {
+            int v = p_queue[k];
+            const int back[4] = {v - p_w, v - 1, v + p_w, v + 1};
+            int best = INT_MAX;
+            for (int b : back) {
+                if (p_open[b] && (p_mark[b] != p_stamp)) {
+                    best = std::min(best, p_dist[b] + 1);
+                }
+            }
+            if (best != INT_MAX) {
+                p_heap.push_back({best, v});
+                std::push_heap(p_heap.begin(), p_heap.end(), std::greater<std::pair<int, int>>());
+            }
+        }
+        while (!p_heap.empty()) {
+            std::pop_heap(p_heap.begin(), p_heap.end(), std::greater<std::pair<int, int>>());
+            auto top = p_heap.back();
+            p_heap.pop_back();
+            int d = top.first;
+            int v = top.second;
+            if ((p_dist[v] != -1) && (p_dist[v] <= d)) {
+                continue;
+            }
+            p_dist[v] = d;
+            const int next[4] = {v - p_w, v - 1, v + p_w, v + 1};
+            for (int n : next) {
+                if (p_open[n] && (p_mark[n] == p_stamp) && ((p_dist[n] == -1) || (p_dist[n] > d + 1))) {
+                    p_heap.push_back({d + 1, n});
+                    std::push_heap(p_heap.begin(), p_heap.end(), std::greater<std::pair<int, int>>());
+                }
+            }
+        }
+
+        // closing i cut part of the maze off, put everything back
+        for (size_t k = 1; k < p_queue.size(); k++) {
+            if (p_dist[p_queue[k]] == -1) {
+                for (auto& s : p_saved) {
+                    p_dist[s.first] = s.second;
+                    p_dist_sum += s.second;
+                }
+                countAround(i, -1);
+                p_open[i] = 1;
+                countAround(i, 1);
+                return false;
+            }
+        }
+        for (size_t k = 1; k < p_queue.size(); k++) {
+            p_dist_sum += p_dist[p_queue[k]];
+        }
+        countSide(i, -1);
+        return true;
+    }
+
+public:
+    // open is indexed by board tile, non-zero for corridor
+    void load(int w, int h, const std::vector<uint8_t>& open, int start_x, int start_y) {
+        p_w = w;
+        p_h = h;
+        p_start = (start_y * w) + start_x;
+        p_open.assign(w * h, 0);
+        for (int y = 1; y < h - 1; y++) {
+            for (int x = 1; x < w - 1; x++) {
+                p_open[(y * w) + x] = open[(y * w) + x] ? 1 : 0;
+            }
+        }
+        p_mark.assign(w * h, 0);
+        p_stamp = 0;
+        recompute();
+    }
+
+    // a MazeBuilder, a MazeGenerator or anything else with their accessors
+    template <typename Maze>
+    void load(const Maze& m) {
+        int w = m.width();
+        int h = m.height();
+        std::vector<uint8_t> open(w * h, 0);
+        for (int y = 1; y < h - 1; y++) {
+            for (int x = 1; x < w - 1; x++) {
+                open[(y * w) + x] = m.at(x, y) == cell_path;
+            }
+        }
+        load(w, h, open, m.startX(), m.startY());
+    }
+
+    // full recount and breadth first search from the start
+    void recompute() {
+        p_cells = p_dead_ends = p_junctions = p_left = p_right = 0;
+        p_dist_sum = 0;
+        p_dist.assign(p_w * p_h, -1);
+        for (int y = 1; y < p_h - 1; y++) {
+            for (int x = 1; x < p_w - 1; x++) {
+                int i = (y * p_w) + x;
+                if (p_open[i]) {
+                    countSide(i, 1);
+                    count(i, 1);
+                }
+            }
+        }
+        if (!p_open[p_start]) {
+            return;
+        }
+        p_dist[p_start] = 0;
+        p_queue.clear();
+        p_queue.push_back(p_start);
+        for (size_t head = 0; head < p_queue.size(); head++) {
+            int u = p_queue[head];
+            p_dist_sum += p_dist[u];
+            const int next[4] = {u - p_w, u - 1, u + p_w, u + 1};
+            for (int v : next) {
+                if (p_open[v] && (p_dist[v] == -1)) {
+                    p_dist[v] = p_dist[u] + 1;
+                    p_queue.push_back(v);
+                }
+            }
+        }
+    }
+
+    // flip a tile between corridor and wall, refusing moves that would leave part of the maze
+    // unreachable, break the generator's shape rules (no 2x2 corridor, no corridors touching only
+    // diagonally, no single wall tile ringed by corridor), open the ring along the border or touch the start
+    bool toggle(int x, int y) {
+        if ((x < 2) || (y < 2) || (x > p_w - 3) || (y > p_h - 3)) {
+            return false;
+        }
+        int i = (y * p_w) + x;
+        if (i == p_start) {
+            return false;
+        }
+        return p_open[i] ? closeTile(i) : openTile(i);
+    }
+
+    bool isOpen(int x, int y) const {
+        return p_open[(y * p_w) + x] != 0;
+    }
+    int cells() const {
+        return p_cells;
+    }
+    int deadEnds() const {
+        return p_dead_ends;
+    }
+    int junctions() const {
+        return p_junctions;
+    }
+    int leftCells() const {
+        return p_left;
+    }
+    int rightCells() const {
+        return p_right;
+    }
+    double averageDistance() const {
+        return (p_cells == 0) ? 0.0 : (double) p_dist_sum / p_cells;
+    }
+
+    double score(const MetricWeights& wt) const {
+        double cells = std::max(p_cells, 1);
+        return (wt.dead_ends * (p_dead_ends / cells))
+             + (wt.junctions * (p_junctions / cells))
+             + (wt.balance * (std::abs(p_left - p_right) / cells))
+             + (wt.distance * (averageDistance() / (p_w + p_h)));
+    }
+};
@@ -0,0 +1,313 @@
+#pragma once
+#include "maze.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// wire format shared by mazed and mazec
+// every message is a u32 body length followed by the body, all integers little endian
+//
+// request:  u8 op, u8 format, u16 width, u16 height, u32 count, u64 seed_from
+// generate: u32 count, then per maze u64 seed, u16 width, u16 height, u32 payload length, payload
+//   fmt_grid  payload: one bit per interior tile row by row, lowest bit first, 1 = corridor
+//   fmt_rects payload: u32 n, then n fill walls as u16 x, y, w, h in board tiles
+// stats:    the ServerStats fields in order as u64
+// a rejected request, bad sizes or a reply that could pass max_message, gets an empty body
+
+const char* const default_socket_path = "/tmp/pacman-mazed.sock";
+const uint64_t any_seed = UINT64_MAX;     // seed_from asking for whatever seeds the server has ready
+const uint32_t max_batch = 65536;
+const uint32_t max_message = 64u << 20;
+
+#ifdef MSG_NOSIGNAL
+const int send_flags = MSG_NOSIGNAL;
+#else
+const int send_flags = 0;
+#endif
+
+enum requestOp : uint8_t {
+    op_generate = 1,
+    op_stats = 2
+};
+
+enum mazeFormat : uint8_t {
+    fmt_grid = 0,
+    fmt_rects = 1
+};
+
+struct MazeRequest {
+    uint8_t op = op_generate;
+    uint8_t format = fmt_grid;
+    uint16_t width = 28;
+    uint16_t height = 30;
+    uint32_t count = 1;
+    uint64_t seed_from = any_seed;
+};
+
+struct ServerStats {
+    uint64_t uptime_ms = 0;
+    uint64_t requests = 0;
+    uint64_t mazes = 0;
+    uint64_t bytes_out = 0;
+    uint64_t pool_hits = 0;
+    uint64_t pool_misses = 0;
+    uint64_t p50_us = 0;
+    uint64_t p90_us = 0;
+    uint64_t p99_us = 0;
+    uint64_t p999_us = 0;
+    uint64_t max_us = 0;
+};
+
+class Packet {
+public:
+    std::vector<uint8_t> data;
+    size_t pos = 0;
+
+    void put(uint64_t v, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            data.push_back((uint8_t) (v >> (8 * i)));
+        }
+    }
+    bool get(uint64_t& v, int bytes) {
+        if (data.size() - pos < (size_t) bytes) {
+            return false;
+        }
+        v = 0;
+        for (int i = 0; i < bytes; i++) {
+            v |= (uint64_t) data[pos++] << (8 * i);
+        }
+        return true;
+    }
+};
+
+inline void writeRequest(Packet& p, const MazeRequest& r) {
+    p.put(r.op, 1);
+    p.put(r.format, 1);
+    p.put(r.width, 2);
+    p.put(r.height, 2);
+    p.put(r.count, 4);
+    p.put(r.seed_from, 8);
+}
+
+inline bool readRequest(Packet& p, MazeRequest& r) {
+    uint64_t op, format, w, h, count, seed;
+    if (!p.get(op, 1) || !p.get(format, 1) || !p.get(w, 2) || !p.get(h, 2) || !p.get(count, 4) || !p.get(seed, 8)) {
+        return false;
+    }
+    r = {(uint8_t) op, (uint8_t) format, (uint16_t) w, (uint16_t) h, (uint32_t) count, seed};
+    return true;
+}
+
+inline void writeStats(Packet& p, const ServerStats& s) {
+    for (uint64_t v : {s.uptime_ms, s.requests, s.mazes, s.bytes_out, s.pool_hits, s.pool_misses, s.p50_us, s.p90_us, s.p99_us, s.p999_us, s.max_us}) {
+        p.put(v, 8);
+    }
+}
+
+inline bool readStats(Packet& p, ServerStats& s) {
+    uint64_t* fields[] = {&s.uptime_ms, &s.requests, &s.mazes, &s.bytes_out, &s.pool_hits, &s.pool_misses, &s.p50_us, &s.p90_us, &s.p99_us, &s.p999_us, &s.max_us};
+    for (auto f : fields) {
+        if (!p.get(*f, 8)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// a generated maze as the server keeps it in its pool
+struct PackedMaze {
+    uint64_t seed = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> corridors;     // one bit per interior tile, fmt_grid payload
+    std::vector<WallRect> rects;
+};
+
+inline void packMaze(const MazeBuilder& m, uint64_t seed, PackedMaze& out) {
+    out.seed = seed;
+    out.width = m.width();
+    out.height = m.height();
+    auto& grid = m.grid();
+    out.corridors.assign((grid.size() + 7) / 8, 0);
+    for (size_t i = 0; i < grid.size(); i++) {
+        if (grid[i] == cell_path) {
+            out.corridors[i / 8] |= (uint8_t) (1 << (i % 8));
+        }
+    }
+    out.rects = m.rects();
+}
+
+// the most bytes a generate reply can take. fill walls can overlap, but each of MazeBuilder's fill passes
+// only adds a wall over at least one tile that was still empty, so a maze has at most one per interior
+// tile. handleGenerate checks the packed reply against this too, in case a generator ever breaks that
+inline uint64_t replyBound(const MazeRequest& r) {
+    uint64_t tiles = (uint64_t) (r.width - 2) * (r.height - 2);
+    uint64_t payload = (r.format == fmt_rects) ? (4 + (8 * tiles)) : ((tiles + 7) / 8);
+    return 4 + ((uint64_t) r.count * (16 + payload));
+}
+
+inline void writeMaze(Packet& p, const PackedMaze& m, uint8_t format) {
+    p.put(m.seed, 8);
+    p.put(m.width, 2);
+    p.put(m.height, 2);
+    if (format == fmt_rects) {
+        p.put(4 + (8 * m.rects.size()), 4);
+        p.put(m.rects.size(), 4);
+        for (auto& r : m.rects) {
+            p.put(r.x, 2);
+            p.put(r.y, 2);
+            p.put(r.w, 2);
+            p.put(r.h, 2);
+        }
+    } else {
+        p.put(m.corridors.size(), 4);
+        p.data.insert(p.data.end(), m.corridors.begin(), m.corridors.end());
+    }
+}
+
+// log-linear latency buckets in microseconds, 8 per power of two, safe to record from any thread
+class LatencyHistogram {
+    static const int p_buckets = 16 + (40 * 8);
+    std::atomic<uint64_t> p_counts[p_buckets];
+    std::atomic<uint64_t> p_max;
+
+    static int bucketOf(uint64_t us) {
+        if (us < 16) {
+            return (int) us;
+        }
+        int b = 63 - __builtin_clzll(us);
+        int idx = 16 + ((b - 4) * 8) + (int) ((us >> (b - 3)) & 7);
+        return std::min(idx, p_buckets - 1);
+    }
+    static uint64_t upperBound(int idx) {
+        if (idx < 16) {
+            return idx;
+        }
+        int b = ((idx - 16) / 8) + 4;
+        uint64_t sub = (idx - 16) % 8;
+        return ((8 + sub + 1) << (b - 3)) - 1;
+    }
+public:
+    LatencyHistogram() {
+        reset();
+    }
+    void reset() {
+        for (auto& c : p_counts) {
+            c = 0;
+        }
+        p_max = 0;
+    }
+    void record(uint64_t us) {
+        p_counts[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t m = p_max.load(std::memory_order_relaxed);
+        while ((us > m) && !p_max.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+    }
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < p_buckets; i++) {
+            p_counts[i] += other.p_counts[i].load();
+        }
+        p_max = std::max(p_max.load(), other.p_max.load());
+    }
+    uint64_t count() const {
+        uint64_t n = 0;
+        for (auto& c : p_counts) {
+            n += c.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+    uint64_t max() const {
+        return p_max.load();
+    }
+    // upper edge of the bucket holding the q quantile, within 1/8 of the true value
+    uint64_t percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) {
+            return 0;
+        }
+        uint64_t target = (uint64_t) (q * (n - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < p_buckets; i++) {
+            seen += p_counts[i].load(std::memory_order_relaxed);
+            if (seen >= target) {
+                return std::min(upperBound(i), max());
+            }
+        }
+        return max();
+    }
+};
+
+inline bool readFull(int fd, void* buf, size_t n) {
+    auto p = (uint8_t*) buf;
+    while (n > 0) {
+        ssize_t r = ::read(fd, p, n);
+        if (r <= 0) {
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+inline bool writeFull(int fd, const void* buf, size_t n) {
+    auto p = (const uint8_t*) buf;
+    while (n > 0) {
+        ssize_t r = ::send(fd, p, n, send_flags);
+        if (r <= 0) {
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+inline bool sendMessage(int fd, const Packet& p) {
+    uint8_t len[4];
+    for (int i = 0; i < 4; i++) {
+        len[i] = (uint8_t) (p.data.size() >> (8 * i));
+    }
+    return writeFull(fd, len, 4) && writeFull(fd, p.data.data(), p.data.size());
+}
+
+inline bool recvMessage(int fd, Packet& p) {
+    uint8_t len[4];
+    if (!readFull(fd, len, 4)) {
+        return false;
+    }
+    uint32_t n = len[0] | (len[1] << 8) | (len[2] << 16) | ((uint32_t) len[3] << 24);
+    if (n > max_message) {
+        return false;
+    }
+    p.data.resize(n);
+    p.pos = 0;
+    return readFull(fd, p.data.data(), n);
+}
+
+inline bool socketAddress(const std::string& path, sockaddr_un& addr) {
+    addr = sockaddr_un();
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    std::copy(path.begin(), path.end(), addr.sun_path);
+    return true;
+}
+
+inline int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!socketAddress(path, addr)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((fd >= 0) && (::connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0)) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
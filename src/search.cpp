@@ -0,0 +1,163 @@
+#include "check.hpp"
+#include "maze.hpp"
+#include "mazefile.hpp"
+#include "metrics.hpp"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// simulated annealing over a finished maze: toggle one tile at a time, score with MazeMetrics
+// and keep the change with the Metropolis rule, cooling geometrically from --t0 to --t1
+// usage: search [--seed N] [--iterations N] [--t0 T] [--t1 T] [--dead-ends W] [--junctions W]
+//               [--balance W] [--distance W] [--check N] [--out FILE]
+// the best maze gets its fill walls from MazeBuilder's fill passes and has to pass verify's checks,
+// it is written as a maze file (mazefile.hpp) that main --maze and verify --maze load
+
+void printMetrics(const char* label, const MazeMetrics& m, const MetricWeights& wt) {
+    std::cout << label << ": score " << m.score(wt) << ", " << m.cells() << " corridor tiles, "
+              << m.deadEnds() << " dead ends, " << m.junctions() << " junctions, "
+              << m.leftCells() << "/" << m.rightCells() << " left/right, "
+              << m.averageDistance() << " average distance from start\n";
+}
+
+// the corridors of m with fill walls from the builder's fill passes
+void fillMaze(MazeBuilder& out, const MazeMetrics& m) {
+    int gw = out.width() - 2;
+    int gh = out.height() - 2;
+    std::vector<uint8_t> cells(gw * gh, cell_empty);
+    for (int y = 1; y <= gh; y++) {
+        for (int x = 1; x <= gw; x++) {
+            if (m.isOpen(x, y)) {
+                cells[out.toGridIndex(x, y)] = cell_path;
+            }
+        }
+    }
+    out.loadCorridors(cells.data(), gw);
+    out.generate();
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t seed = 1;
+    uint64_t iterations = 5000000;
+    double t0 = 0.02;
+    double t1 = 0.0001;
+    uint64_t check_every = 0;
+    std::string out_path;
+    MetricWeights wt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << "\n";
+            return 2;
+        }
+        if (arg == "--seed") {
+            seed = (uint32_t) std::stoul(argv[++i]);
+        } else if (arg == "--iterations") {
+            iterations = std::stoull(argv[++i]);
+        } else if (arg == "--t0") {
+            t0 = std::stod(argv[++i]);
+        } else if (arg == "--t1") {
+            t1 = std::stod(argv[++i]);
+        } else if (arg == "--dead-ends") {
+            wt.dead_ends = std::stod(argv[++i]);
+        } else if (arg == "--junctions") {
+            wt.junctions = std::stod(argv[++i]);
+        } else if (arg == "--balance") {
+            wt.balance = std::stod(argv[++i]);
+        } else if (arg == "--distance") {
+            wt.distance = std::stod(argv[++i]);
+        } else if (arg == "--check") {
+            check_every = std::stoull(argv[++i]);
+        } else if (arg == "--out") {
+            out_path = argv[++i];
+        } else {
+            std::cerr << "unknown option " << arg << "\n";
+            return 2;
+        }
+    }
+
+    MazeBuilder builder(seed);
+    builder.generate();
+    int w = builder.width();
+    int h = builder.height();
+    MazeMetrics m;
+    m.load(builder);
+    printMetrics("generated", m, wt);
+
+    std::mt19937 rng(seed);
+    // the same range MazeMetrics::toggle accepts, so no draw is wasted
+    std::uniform_int_distribution<int> pick_x(2, w - 3);
+    std::uniform_int_distribution<int> pick_y(2, h - 3);
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    double score = m.score(wt);
+    double best_score = score;
+    // toggles accepted since the best, undone once at the end instead of copying the metrics on every new best
+    std::vector<std::pair<int, int>> since_best;
+    uint64_t evaluated = 0;
+    uint64_t accepted = 0;
+    double cooling = std::pow(t1 / t0, 1.0 / std::max<uint64_t>(iterations, 1));
+    double temp = t0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t it = 0; it < iterations; it++, temp *= cooling) {
+        int x = pick_x(rng);
+        int y = pick_y(rng);
+        if (!m.toggle(x, y)) {
+            continue;
+        }
+        evaluated++;
+        double new_score = m.score(wt);
+        double delta = new_score - score;
+        if ((delta >= 0) || (coin(rng) < std::exp(delta / temp))) {
+            score = new_score;
+            accepted++;
+            if (score > best_score) {
+                best_score = score;
+                since_best.clear();
+            } else {
+                since_best.emplace_back(x, y);
+            }
+        } else {
+            m.toggle(x, y);
+        }
+
+        if ((check_every != 0) && ((evaluated % check_every) == 0)) {
+            MazeMetrics full = m;
+            full.recompute();
+            if ((full.deadEnds() != m.deadEnds()) || (full.junctions() != m.junctions()) || (full.averageDistance() != m.averageDistance())) {
+                std::cerr << "incremental metrics drifted from a full recompute after " << evaluated << " candidates\n";
+                return 1;
+            }
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto it = since_best.rbegin(); it != since_best.rend(); ++it) {
+        m.toggle(it->first, it->second);
+    }
+    printMetrics("best", m, wt);
+    std::cout << iterations << " moves, " << evaluated << " candidates scored, " << accepted << " accepted in " << secs << "s ("
+              << (uint64_t) (evaluated / std::max(secs, 1e-9) * 60.0) << " candidates/min)\n";
+
+    fillMaze(builder, m);
+    std::vector<uint8_t> cover;
+    std::vector<int> queue;
+    std::vector<Failure> failures;
+    checkMaze(builder, seed, cover, queue, failures);
+    for (auto& fl : failures) {
+        std::cerr << "best maze breaks " << invariant_names[fl.inv] << " at " << fl.x << "," << fl.y << "\n";
+    }
+    if (out_path.empty()) {
+        writeMazeFile(std::cout, builder);
+    } else {
+        std::ofstream f(out_path);
+        writeMazeFile(f, builder);
+    }
+    return failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// scoped timers for profiling, exported as Chrome trace json for chrome://tracing or ui.perfetto.dev
+// each thread writes its own ring buffer without locking, recording is off until Tracer::start
+// and a TRACE_SCOPE that is compiled in but not recording costs one relaxed atomic load
+
+struct TraceEvent {
+    const char* name;       // not copied, string literals or other static names only
+    uint64_t start_ns;
+    uint64_t dur_ns;
+};
+
+// single writer ring: the owning thread fills a slot and then publishes it by bumping head,
+// an exporting thread copies behind it and drops the slots the writer may have reused meanwhile
+class TraceRing {
+public:
+    static const uint64_t capacity = 1 << 16;
+    uint32_t tid = 0;
+    std::string name;
+    std::unique_ptr<TraceEvent[]> slots = std::unique_ptr<TraceEvent[]>(new TraceEvent[capacity]);
+    std::atomic<uint64_t> head{0};
+
+    void push(const TraceEvent& e) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        slots[h & (capacity - 1)] = e;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void copyTo(std::vector<TraceEvent>& out, uint64_t since_ns) const {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = (end > capacity) ? (end - capacity) : 0;
+        size_t first = out.size();
+        for (uint64_t i = begin; i < end; i++) {
+            out.push_back(slots[i & (capacity - 1)]);
+        }
+        // anything at or below the writer's current position minus capacity may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = head.load(std::memory_order_relaxed);
+        uint64_t safe = (now >= capacity) ? (now - capacity + 1) : 0;
+        size_t skip = (size_t) (std::max(safe, begin) - begin);
+        out.erase(out.begin() + first, out.begin() + first + std::min(skip, out.size() - first));
+        out.erase(std::remove_if(out.begin() + first, out.end(), [&](const TraceEvent& e) {
+            return e.start_ns < since_ns;
+        }), out.end());
+    }
+};
+
+class Tracer {
+    std::mutex p_mutex;
+    std::vector<std::unique_ptr<TraceRing>> p_rings;
+    std::chrono::steady_clock::time_point p_epoch = std::chrono::steady_clock::now();
+    uint64_t p_since_ns = 0;
+    std::atomic<bool> p_enabled{false};
+
+    Tracer() {}
+public:
+    static Tracer& get() {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    bool enabled() const {
+        return p_enabled.load(std::memory_order_relaxed);
+    }
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - p_epoch).count();
+    }
+
+    // the calling thread's ring, registered on first use and kept for the life of the process
+    TraceRing& ring() {
+        thread_local TraceRing* r = nullptr;
+        if (r == nullptr) {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            p_rings.emplace_back(new TraceRing());
+            r = p_rings.back().get();
+            r->tid = (uint32_t) p_rings.size();
+            r->name = "thread " + std::to_string(r->tid);
+        }
+        return *r;
+    }
+    void setThreadName(const std::string& name) {
+        ring().name = name;
+    }
+
+    // events from before the last start are left out of the export
+    void start() {
+        p_since_ns = now();
+        p_enabled = true;
+    }
+    void stop() {
+        p_enabled = false;
+    }
+
+    bool writeChromeTrace(const std::string& path) {
+        std::vector<std::pair<const TraceRing*, std::vector<TraceEvent>>> copies;
+        {
+            std::lock_guard<std::mutex> lock(p_mutex);
+            for (auto& r : p_rings) {
+                copies.emplace_back(r.get(), std::vector<TraceEvent>());
+                r->copyTo(copies.back().second, p_since_ns);
+            }
+        }
+        std::ofstream f(path);
+        f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        char buf[256];
+        for (auto& c : copies) {
+            snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     c.first->tid, c.first->name.c_str());
+            f << (first ? "" : ",\n") << buf;
+            first = false;
+            for (auto& e : c.second) {
+                snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         e.name, c.first->tid, (e.start_ns - p_since_ns) / 1000.0, e.dur_ns / 1000.0);
+                f << buf;
+            }
+        }
+        f << "\n]}\n";
+        return (bool) f;
+    }
+};
+
+class TraceScope {
+    const char* p_name;
+    uint64_t p_start = 0;
+    bool p_on;
+public:
+    explicit TraceScope(const char* name)
+        : p_name(name), p_on(Tracer::get().enabled()) {
+        if (p_on) {
+            p_start = Tracer::get().now();
+        }
+    }
+    ~TraceScope() {
+        if (p_on) {
+            auto& t = Tracer::get();
+            t.ring().push({p_name, p_start, t.now() - p_start});
+        }
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+// rolling window of the most recent frame times in milliseconds
+class FrameTimes {
+    std::vector<float> p_ms;
+    size_t p_next = 0;
+    size_t p_count = 0;
+public:
+    FrameTimes(size_t window = 240)
+        : p_ms(window, 0.f) {}
+
+    void add(float ms) {
+        p_ms[p_next] = ms;
+        p_next = (p_next + 1) % p_ms.size();
+        p_count = std::min(p_count + 1, p_ms.size());
+    }
+    size_t size() const {
+        return p_count;
+    }
+    // i counts back from the newest frame
+    float recent(size_t i) const {
+        return p_ms[(p_next + p_ms.size() - 1 - i) % p_ms.size()];
+    }
+    float percentile(double q) const {
+        if (p_count == 0) {
+            return 0.f;
+        }
+        std::vector<float> sorted(p_ms.begin(), p_ms.begin() + p_count);
+        size_t k = std::min(p_count - 1, (size_t) (q * (p_count - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+};
@@ -0,0 +1,258 @@
+#include "check.hpp"
+#include "chunked.hpp"
+#include "generator.hpp"
+#include "maze.hpp"
+#include "mazefile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// sweeps a seed range through the generator and checks every maze against the generator's rules
+// usage: verify [--from N] [--count N] [--shard I/K] [--threads T] [--out FILE] [--symmetric] [--regen N]
+//               [--generator walk|pieces]
+//        verify --giant N [--chunk N] [--from N] [--count N] [--threads T] [--out FILE]
+//        verify --maze FILE
+// a seed range can be split across processes with --shard, each process splits its shard across threads
+// --regen re-rolls N random regions of every maze with MazeBuilder::regenerate before checking it
+// --generator picks the strategy from generator.hpp, --symmetric and --regen only apply to the walk
+// --giant checks N x N boards from ChunkedMaze instead, one at a time with the threads generating each
+// --maze checks a single maze file, such as the one search writes
+
+// one N x N chunked board per seed, generated with all the threads and checked on this one
+int verifyGiant(int size, int chunk, uint64_t from, uint64_t count, int threads, const std::string& out_path) {
+    ChunkedMaze m(size, size, chunk);
+    std::vector<uint8_t> cover;
+    std::vector<int> queue;
+    std::vector<Failure> failures;
+    uint64_t per_invariant[inv_count] = {};
+    uint64_t failing_seeds = 0;
+    std::ofstream f(out_path);
+    f << "# seed invariant x y (board tile of the first offending cell) or seed missing_door, reproduce with: verify --giant " << size << " --chunk " << chunk << " --from <seed> --count 1\n";
+    for (uint64_t seed = from; seed < from + count; seed++) {
+        bool doors = m.generate((uint32_t) seed, threads);
+        failures.clear();
+        checkMaze(m, (uint32_t) seed, cover, queue, failures);
+        for (auto& fl : failures) {
+            per_invariant[fl.inv]++;
+            f << fl.seed << " " << invariant_names[fl.inv] << " " << fl.x << " " << fl.y << "\n";
+        }
+        if (!doors) {
+            f << seed << " missing_door\n";
+        }
+        failing_seeds += (failures.empty() && doors) ? 0 : 1;
+        auto& t = m.times();
+        std::cout << "seed " << seed << ": " << m.chunks() << " chunks, " << m.doors() << " doors, " << m.missingDoors()
+                  << " seams without a door, " << (t.carve + t.stitch + t.fill + t.seams) << "s on " << threads << " threads\n";
+    }
+    std::cout << failing_seeds << " failing seeds written to " << out_path << "\n";
+    for (int i = 0; i < inv_count; i++) {
+        std::cout << "  " << invariant_names[i] << ": " << per_invariant[i] << "\n";
+    }
+    return (failing_seeds == 0) ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t from = 0;
+    uint64_t count = 1000000;
+    bool count_given = false;
+    int giant = 0;
+    int chunk = 64;
+    int shard = 0;
+    int shards = 1;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string out_path = "verify_failures.txt";
+    bool symmetric = false;
+    int regen = 0;
+    std::string generator = "walk";
+    std::string maze_path;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--from") && (i + 1 < argc)) {
+            from = std::stoull(argv[++i]);
+        } else if ((arg == "--count") && (i + 1 < argc)) {
+            count = std::stoull(argv[++i]);
+            count_given = true;
+        } else if ((arg == "--shard") && (i + 1 < argc)) {
+            std::string s = argv[++i];
+            auto slash = s.find('/');
+            if (slash == std::string::npos) {
+                std::cerr << "--shard expects I/K\n";
+                return 2;
+            }
+            shard = std::stoi(s.substr(0, slash));
+            shards = std::stoi(s.substr(slash + 1));
+        } else if ((arg == "--threads") && (i + 1 < argc)) {
+            threads = std::max(1, std::stoi(argv[++i]));
+        } else if ((arg == "--out") && (i + 1 < argc)) {
+            out_path = argv[++i];
+        } else if (arg == "--symmetric") {
+            symmetric = true;
+        } else if ((arg == "--regen") && (i + 1 < argc)) {
+            regen = std::max(0, std::stoi(argv[++i]));
+        } else if ((arg == "--maze") && (i + 1 < argc)) {
+            maze_path = argv[++i];
+        } else if ((arg == "--generator") && (i + 1 < argc)) {
+            generator = argv[++i];
+        } else if ((arg == "--giant") && (i + 1 < argc)) {
+            giant = std::max(0, std::stoi(argv[++i]));
+        } else if ((arg == "--chunk") && (i + 1 < argc)) {
+            chunk = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "usage: verify [--from N] [--count N] [--shard I/K] [--threads T] [--out FILE] [--symmetric] [--regen N]\n"
+                      << "              [--generator walk|pieces]\n"
+                      << "       verify --giant N [--chunk N] [--from N] [--count N] [--threads T] [--out FILE]\n"
+                      << "       verify --maze FILE\n";
+            return 2;
+        }
+    }
+    if (!maze_path.empty()) {
+        std::ifstream f(maze_path);
+        MazeFile maze;
+        if (!readMazeFile(f, maze)) {
+            std::cerr << "could not read maze " << maze_path << "\n";
+            return 2;
+        }
+        std::vector<uint8_t> cover;
+        std::vector<int> queue;
+        std::vector<Failure> failures;
+        checkMaze(maze, 0, cover, queue, failures);
+        for (auto& fl : failures) {
+            std::cout << invariant_names[fl.inv] << " " << fl.x << " " << fl.y << "\n";
+        }
+        std::cout << maze_path << ": " << failures.size() << " broken invariants\n";
+        return failures.empty() ? 0 : 1;
+    }
+    if (giant > 0) {
+        if (symmetric || (regen > 0) || (shards > 1)) {
+            std::cerr << "--giant can't be combined with --symmetric, --regen or --shard\n";
+            return 2;
+        }
+        return verifyGiant(std::max(giant, 12), chunk, from, count_given ? count : 1, threads, out_path);
+    }
+    if (!makeGenerator(generator)) {
+        std::cerr << "unknown generator " << generator << "\n";
+        return 2;
+    }
+    if ((generator != "walk") && (symmetric || (regen > 0))) {
+        std::cerr << "--symmetric and --regen need the walk generator\n";
+        return 2;
+    }
+    if ((regen > 0) && symmetric) {
+        std::cerr << "--regen needs an asymmetric board\n";
+        return 2;
+    }
+    if ((shards < 1) || (shard < 0) || (shard >= shards)) {
+        std::cerr << "bad shard " << shard << "/" << shards << "\n";
+        return 2;
+    }
+
+    // this process's contiguous slice of the range
+    uint64_t begin = from + (count * shard) / shards;
+    uint64_t end = from + (count * (shard + 1)) / shards;
+
+    const uint64_t batch = 4096;
+    std::atomic<uint64_t> next(begin);
+    std::atomic<uint64_t> checked(0);
+    std::atomic<uint64_t> regen_kept(0);
+    std::mutex out_mutex;
+    std::vector<Failure> failures;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            MazeBuilder m(0);
+            m.setSymmetric(symmetric);
+            // the walk stays on the builder so --regen can reach it
+            std::unique_ptr<MazeGenerator> other = (generator != "walk") ? makeGenerator(generator) : nullptr;
+            std::vector<uint8_t> cover;
+            std::vector<int> queue;
+            std::vector<Failure> local;
+            for (uint64_t lo = next.fetch_add(batch); lo < end; lo = next.fetch_add(batch)) {
+                uint64_t hi = std::min(end, lo + batch);
+                for (uint64_t seed = lo; seed < hi; seed++) {
+                    if (other) {
+                        other->generate((uint32_t) seed, m.width(), m.height(), m.startX(), m.startY());
+                        checkMaze(*other, (uint32_t) seed, cover, queue, local);
+                        continue;
+                    }
+                    m.reset((uint32_t) seed);
+                    m.generate();
+                    std::mt19937 rng((uint32_t) seed);
+                    for (int r = 0; r < regen; r++) {
+                        std::uniform_int_distribution<int> rw(1, m.width() - 2);
+                        std::uniform_int_distribution<int> rh(1, m.height() - 2);
+                        WallRect region = {rw(rng), rh(rng), rw(rng), rh(rng)};
+                        region.w = std::min(region.w, m.width() - 1 - region.x);
+                        region.h = std::min(region.h, m.height() - 1 - region.y);
+                        if (!m.regenerate(region, rng())) {
+                            regen_kept++;
+                        }
+                    }
+                    checkMaze(m, (uint32_t) seed, cover, queue, local);
+                }
+                checked += hi - lo;
+            }
+            std::lock_guard<std::mutex> lock(out_mutex);
+            failures.insert(failures.end(), local.begin(), local.end());
+        });
+    }
+
+    // progress every few seconds while the workers run
+    uint64_t total = end - begin;
+    double last = 0;
+    while (checked < total) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (secs - last >= 5.0) {
+            last = secs;
+            std::cerr << checked << "/" << total << " seeds, " << (uint64_t) (checked / secs) << " seeds/s\n";
+        }
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(failures.begin(), failures.end(), [](const Failure& a, const Failure& b) {
+        return (a.seed < b.seed) || ((a.seed == b.seed) && (a.inv < b.inv));
+    });
+    uint64_t per_invariant[inv_count] = {};
+    uint64_t failing_seeds = 0;
+    for (size_t i = 0; i < failures.size(); i++) {
+        per_invariant[failures[i].inv]++;
+        if ((i == 0) || (failures[i].seed != failures[i - 1].seed)) {
+            failing_seeds++;
+        }
+    }
+
+    std::ofstream f(out_path);
+    // main can't replay the re-rolled regions, verify rolls the same ones for a seed
+    std::string flags = std::string(symmetric ? " --symmetric" : "") + ((generator != "walk") ? " --generator " + generator : "");
+    if (regen > 0) {
+        f << "# seed invariant x y (board tile of the first offending cell), reproduce with: verify --from <seed> --count 1 --regen " << regen << flags << "\n";
+    } else {
+        f << "# seed invariant x y (board tile of the first offending cell), reproduce with: main --seed <seed>" << flags << "\n";
+    }
+    for (auto& fl : failures) {
+        f << fl.seed << " " << invariant_names[fl.inv] << " " << fl.x << " " << fl.y << "\n";
+    }
+
+    std::cout << "shard " << shard << "/" << shards << ": " << generator << " seeds [" << begin << ", " << end << ") on " << threads << " threads\n";
+    std::cout << total << " mazes in " << secs << "s, " << (uint64_t) (total / std::max(secs, 1e-9)) << " mazes/s\n";
+    if (regen > 0) {
+        std::cout << (total * regen) << " regions re-rolled, " << regen_kept << " kept their old corridors\n";
+    }
+    std::cout << failing_seeds << " failing seeds written to " << out_path << "\n";
+    for (int i = 0; i < inv_count; i++) {
+        std::cout << "  " << invariant_names[i] << ": " << per_invariant[i] << "\n";
+    }
+    return (failing_seeds == 0) ? 0 : 1;
+}